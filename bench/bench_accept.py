@@ -0,0 +1,100 @@
+"""accept storm, connections opened by client processes as fast as they can."""
+import os
+import selectors
+import time
+from socket import *
+
+from py_io_uring import IoUring, IORING_CQE_F_MORE
+
+from common import mp, result
+
+CLIENTS = 4
+
+
+def connector(addr, n, start):
+    start.wait()
+    for i in range(n):
+        sock = socket(AF_INET, SOCK_STREAM)
+        try:
+            sock.connect(addr)
+        except OSError:
+            pass
+        sock.close()
+
+
+def storm(server, accept_all, connections):
+    """start clients and call accept_all(n) until n connections are accepted,
+    return seconds from the start signal to the last accept."""
+    start = mp.Event()
+    per_client = connections // CLIENTS
+    procs = [mp.Process(target=connector, args=(server.getsockname(), per_client, start))
+            for i in range(CLIENTS)]
+    for p in procs:
+        p.start()
+    begin = time.perf_counter()
+    start.set()
+    accept_all(per_client * CLIENTS)
+    elapsed = time.perf_counter() - begin
+    for p in procs:
+        p.join()
+    return per_client * CLIENTS, elapsed
+
+
+def ring_accept(server):
+    def accept_all(n):
+        # created after the clients are forked
+        ring = IoUring()
+        ring.queue_init(256, 0)
+        sqe = ring.get_sqe()
+        sqe.prep_multishot_accept(server.fileno())
+        sqe.set_data("accept")
+        ring.submit()
+        while n > 0:
+            for data, fd, flags in ring.drain(1):
+                if fd >= 0:
+                    os.close(fd)
+                    n -= 1
+                if not flags & IORING_CQE_F_MORE:
+                    # multishot accept ended, e.g. by a full cq, arm it again
+                    sqe = ring.get_sqe()
+                    sqe.prep_multishot_accept(server.fileno())
+                    sqe.set_data("accept")
+                    ring.submit()
+        # cancel with the ring
+        ring.queue_exit()
+    return accept_all
+
+
+def selectors_accept(server):
+    def accept_all(n):
+        server.setblocking(False)
+        with selectors.DefaultSelector() as sel:
+            sel.register(server, selectors.EVENT_READ)
+            while n > 0:
+                sel.select()
+                while n > 0:
+                    try:
+                        conn, addr = server.accept()
+                    except BlockingIOError:
+                        break
+                    conn.close()
+                    n -= 1
+    return accept_all
+
+
+def blocking_accept(server):
+    def accept_all(n):
+        for i in range(n):
+            conn, addr = server.accept()
+            conn.close()
+    return accept_all
+
+
+def run(args):
+    for name, make in [("ring_multishot", ring_accept), ("selectors", selectors_accept),
+            ("blocking", blocking_accept)]:
+        with socket(AF_INET, SOCK_STREAM) as server:
+            server.bind(("127.0.0.1", 0))
+            server.listen(4096)
+            ops, elapsed = storm(server, make(server), args.accepts)
+        yield result("accept", name, {"connections": ops, "clients": CLIENTS}, ops, elapsed)
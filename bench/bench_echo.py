@@ -0,0 +1,150 @@
+"""loopback echo, the same client against ring, selectors and asyncio servers."""
+import asyncio
+import selectors
+import time
+from socket import *
+
+from py_io_uring import IoUring
+from py_io_uring_asyncio import IoUringEventLoop
+
+from common import percentiles, result, start_server, stop_server
+
+MESSAGE = b"x" * 64
+
+
+def listen():
+    server = socket(AF_INET, SOCK_STREAM)
+    server.setsockopt(SOL_SOCKET, SO_REUSEADDR, 1)
+    server.bind(("127.0.0.1", 0))
+    server.listen(128)
+    return server
+
+
+def ring_server(conn):
+    ring = IoUring()
+    ring.queue_init(256, 0)
+    server = listen()
+
+    def accepted(fd):
+        if fd < 0:
+            return
+        sqe = ring.get_sqe()
+        sqe.prep_recv(fd, 4096)
+        sqe.set_callback(received, fd)
+
+    def received(data, fd):
+        if isinstance(data, int) or not data:
+            sqe = ring.get_sqe()
+            sqe.prep_close(fd)
+            return
+        sqe = ring.get_sqe()
+        sqe.prep_send(fd, data)
+        sqe = ring.get_sqe()
+        sqe.prep_recv(fd, 4096)
+        sqe.set_callback(received, fd)
+
+    sqe = ring.get_sqe()
+    sqe.prep_multishot_accept(server.fileno())
+    sqe.set_callback(accepted)
+    conn.send(server.getsockname())
+    while True:
+        ring.run(256)
+
+
+def selectors_server(conn):
+    sel = selectors.DefaultSelector()
+    server = listen()
+    server.setblocking(False)
+    sel.register(server, selectors.EVENT_READ)
+    conn.send(server.getsockname())
+    while True:
+        for key, events in sel.select():
+            sock = key.fileobj
+            if sock is server:
+                client, addr = server.accept()
+                client.setblocking(False)
+                sel.register(client, selectors.EVENT_READ)
+                continue
+            data = sock.recv(4096)
+            if not data:
+                sel.unregister(sock)
+                sock.close()
+                continue
+            sock.sendall(data)
+
+
+class EchoProtocol(asyncio.Protocol):
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def data_received(self, data):
+        self.transport.write(data)
+
+
+def asyncio_server(conn, loop_factory=asyncio.new_event_loop):
+    loop = loop_factory()
+    server = listen()
+    loop.run_until_complete(loop.create_server(EchoProtocol, sock=server))
+    conn.send(server.getsockname())
+    loop.run_forever()
+
+
+def io_uring_loop_server(conn):
+    asyncio_server(conn, IoUringEventLoop)
+
+
+def client(addr, connections, duration):
+    """ping-pong on every connection, one request outstanding on each.
+    return number of requests and their round trip times."""
+    sel = selectors.DefaultSelector()
+    sent = {}
+    for i in range(connections):
+        sock = create_connection(addr)
+        sock.setsockopt(IPPROTO_TCP, TCP_NODELAY, 1)
+        sock.setblocking(False)
+        sel.register(sock, selectors.EVENT_READ, [b""])
+    samples = []
+    start = time.perf_counter()
+    end = start + duration
+    for key in sel.get_map().values():
+        sent[key.fileobj] = time.perf_counter()
+        key.fileobj.send(MESSAGE)
+    while True:
+        now = time.perf_counter()
+        if now >= end:
+            break
+        for key, events in sel.select(1):
+            sock = key.fileobj
+            key.data[0] += sock.recv(4096)
+            if len(key.data[0]) < len(MESSAGE):
+                continue
+            now = time.perf_counter()
+            samples.append(now - sent[sock])
+            key.data[0] = b""
+            sent[sock] = now
+            sock.send(MESSAGE)
+    elapsed = time.perf_counter() - start
+    for key in list(sel.get_map().values()):
+        key.fileobj.close()
+    sel.close()
+    return samples, elapsed
+
+
+SERVERS = [
+    ("ring_run", ring_server),
+    ("selectors", selectors_server),
+    ("asyncio", asyncio_server),
+    ("asyncio_io_uring", io_uring_loop_server),
+]
+
+
+def run(args):
+    for name, target in SERVERS:
+        proc, addr = start_server(target)
+        try:
+            samples, elapsed = client(addr, args.connections, args.duration)
+        finally:
+            stop_server(proc)
+        yield result("echo", name, {"connections": args.connections,
+                "message": len(MESSAGE)}, len(samples), elapsed, **percentiles(samples))
@@ -0,0 +1,79 @@
+"""sequential and random 4k reads of a cached file at several queue depths."""
+import os
+import random
+import tempfile
+
+from py_io_uring import IoUring
+
+from common import Deadline, result
+
+BLOCK = 4096
+DEPTHS = [1, 4, 16, 64]
+
+
+def offsets(pattern, blocks, n):
+    if pattern == "seq":
+        return [(i % blocks) * BLOCK for i in range(n)]
+    rand = random.Random(0)
+    return [rand.randrange(blocks) * BLOCK for i in range(n)]
+
+
+def pread_loop(fd, offs, depth, duration):
+    pread = os.pread
+    deadline = Deadline(duration)
+    ops = 0
+    while not deadline.expired():
+        for off in offs:
+            pread(fd, BLOCK, off)
+        ops += len(offs)
+    return ops, deadline.elapsed()
+
+
+def ring_loop(fd, offs, depth, duration):
+    """keep depth reads in flight, each completion queues the next read
+    into the buffer it has filled."""
+    ring = IoUring()
+    ring.queue_init(depth, 0)
+    buffers = [bytearray(BLOCK) for i in range(depth)]
+    noffs = len(offs)
+    ops = 0
+    try:
+        for i in range(depth):
+            sqe = ring.get_sqe()
+            sqe.prep_read_into(fd, buffers[i], offs[i])
+            sqe.set_data(i)
+        next_off = depth
+        deadline = Deadline(duration)
+        while not deadline.expired():
+            for round in range(100):
+                ring.submit()
+                for i, res, flags in ring.drain(1):
+                    sqe = ring.get_sqe()
+                    sqe.prep_read_into(fd, buffers[i], offs[next_off % noffs])
+                    sqe.set_data(i)
+                    next_off += 1
+                    ops += 1
+        elapsed = deadline.elapsed()
+    finally:
+        ring.queue_exit()
+    return ops, elapsed
+
+
+def run(args):
+    with tempfile.NamedTemporaryFile(dir=args.tmpdir) as f:
+        # pages are cached, this measures per-op overhead rather than the disk
+        chunk = os.urandom(1 << 20)
+        for i in range(args.file_mb):
+            f.write(chunk)
+        f.flush()
+        fd = f.fileno()
+        blocks = args.file_mb * (1 << 20) // BLOCK
+        for pattern in ("seq", "rand"):
+            offs = offsets(pattern, blocks, 4096)
+            impls = [("pread", pread_loop, [1])] + [("ring", ring_loop, DEPTHS)]
+            for name, loop, depths in impls:
+                for depth in depths:
+                    ops, elapsed = loop(fd, offs, depth, args.duration)
+                    yield result("file_read", name, {"pattern": pattern,
+                            "depth": depth, "block": BLOCK}, ops, elapsed,
+                            mb_per_sec=round(ops * BLOCK / elapsed / (1 << 20), 1))
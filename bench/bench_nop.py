@@ -0,0 +1,62 @@
+"""NOP submit and complete round trips, the per-op overhead of the extension."""
+from py_io_uring import IoUring, IORING_OP_NOP
+
+from common import Deadline, result
+
+BATCHES = [1, 8, 32, 128]
+
+
+def get_sqe_loop(ring, batch, duration):
+    deadline = Deadline(duration)
+    ops = 0
+    while not deadline.expired():
+        for i in range(100):
+            for j in range(batch):
+                ring.get_sqe().prep_nop()
+            ring.submit()
+            ring.drain(batch)
+        ops += 100 * batch
+    return ops, deadline.elapsed()
+
+
+def submit_ops_loop(ring, batch, duration):
+    ops_list = [(IORING_OP_NOP, -1, None, 0, 0, None)] * batch
+    deadline = Deadline(duration)
+    ops = 0
+    while not deadline.expired():
+        for i in range(100):
+            ring.submit_ops(ops_list)
+            ring.drain(batch)
+        ops += 100 * batch
+    return ops, deadline.elapsed()
+
+
+def callback_loop(ring, batch, duration):
+    def done(res):
+        pass
+    deadline = Deadline(duration)
+    ops = 0
+    while not deadline.expired():
+        for i in range(100):
+            for j in range(batch):
+                sqe = ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_callback(done)
+            ring.run(batch, 0)
+        ops += 100 * batch
+    return ops, deadline.elapsed()
+
+
+def run(args):
+    impls = [("get_sqe", get_sqe_loop), ("submit_ops", submit_ops_loop),
+            ("run_callback", callback_loop)]
+    for batch in BATCHES:
+        for name, loop in impls:
+            ring = IoUring()
+            ring.queue_init(max(BATCHES), 0)
+            try:
+                ops, elapsed = loop(ring, batch, args.duration)
+            finally:
+                ring.queue_exit()
+            yield result("nop", name, {"batch": batch}, ops, elapsed,
+                    ns_per_op=round(elapsed / ops * 1e9, 1))
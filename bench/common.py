@@ -0,0 +1,62 @@
+import multiprocessing
+import time
+
+# fork keeps servers cheap to start and sees the modules imported here
+mp = multiprocessing.get_context("fork")
+
+
+def percentiles(samples):
+    """p50/p99/p999 of latency samples in seconds, as microseconds."""
+    if not samples:
+        return {}
+    samples = sorted(samples)
+    n = len(samples)
+    def at(q):
+        return round(samples[min(n - 1, int(q * n))] * 1e6, 2)
+    return {"p50_us": at(0.5), "p99_us": at(0.99), "p999_us": at(0.999)}
+
+
+def result(bench, impl, params, ops, elapsed, **extra):
+    """one record of the json report."""
+    record = {
+        "bench": bench,
+        "impl": impl,
+        "params": params,
+        "ops": ops,
+        "seconds": round(elapsed, 4),
+        "ops_per_sec": round(ops / elapsed, 1) if elapsed else 0,
+    }
+    record.update(extra)
+    return record
+
+
+class Deadline:
+    """measured loops run until duration seconds have passed, they check it
+    once per round of operations to keep the clock out of the hot path."""
+
+    def __init__(self, duration):
+        self.start = time.perf_counter()
+        self.end = self.start + duration
+
+    def expired(self):
+        return time.perf_counter() >= self.end
+
+    def elapsed(self):
+        return time.perf_counter() - self.start
+
+
+def start_server(target, *args):
+    """run target(conn, *args) in a child process, it sends back the
+    address it listens on. return (process, address)."""
+    parent, child = mp.Pipe()
+    proc = mp.Process(target=target, args=(child,) + args, daemon=True)
+    proc.start()
+    child.close()
+    addr = parent.recv()
+    parent.close()
+    return proc, addr
+
+
+def stop_server(proc):
+    proc.terminate()
+    proc.join(5)
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""run the benchmarks and print a json report, progress goes to stderr.
+
+    python3 bench/run.py [--only nop,echo] [--duration 2] [-o report.json]
+"""
+import argparse
+import datetime
+import json
+import os
+import platform
+import sys
+import tempfile
+
+import bench_accept
+import bench_echo
+import bench_file
+import bench_nop
+
+BENCHES = {
+    "nop": bench_nop,
+    "echo": bench_echo,
+    "file": bench_file,
+    "accept": bench_accept,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--only", default=",".join(BENCHES),
+            help="comma separated benchmarks, of %s" % ", ".join(BENCHES))
+    parser.add_argument("--duration", type=float, default=2.0,
+            help="seconds each measurement runs")
+    parser.add_argument("--connections", type=int, default=8,
+            help="concurrent connections of echo")
+    parser.add_argument("--accepts", type=int, default=20000,
+            help="connections opened by accept")
+    parser.add_argument("--file-mb", type=int, default=64,
+            help="size of the file read by file")
+    parser.add_argument("--tmpdir", default=tempfile.gettempdir(),
+            help="directory of the file read by file")
+    parser.add_argument("-o", "--output", help="write the report here instead of stdout")
+    args = parser.parse_args()
+
+    names = [name for name in args.only.split(",") if name]
+    unknown = set(names) - set(BENCHES)
+    if unknown:
+        parser.error("unknown benchmark: %s" % ", ".join(sorted(unknown)))
+
+    import py_io_uring
+    report = {
+        "meta": {
+            "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+            "python": platform.python_version(),
+            "kernel": platform.release(),
+            "machine": platform.machine(),
+            "cpus": os.cpu_count(),
+            "module": py_io_uring.__file__,
+            "duration": args.duration,
+        },
+        "results": [],
+    }
+    for name in names:
+        for record in BENCHES[name].run(args):
+            print(json.dumps(record), file=sys.stderr)
+            report["results"].append(record)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=1)
+            f.write("\n")
+    else:
+        json.dump(report, sys.stdout, indent=1)
+        print()
+
+
+if __name__ == "__main__":
+    main()
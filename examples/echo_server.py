@@ -1,5 +1,6 @@
 #!/home/luvjoey/.pyenv/versions/python37-debug/bin/python
 import logging
+import os
 from socket import *
 import sys
 
@@ -15,91 +16,56 @@ def listen_on(host, port):
     server.listen(5)
     return server
 
-def accepted(sfd, cqe=None):
-    try:
-        ret = cqe.getresult()
-        breakpoint
-        sqe = ring.get_sqe()
-        sqe.prep_recv(ret, 512)
-        sqe.set_data((recv, ret))
-    except OSError as e:
-        logging.exception("error while accept connection")
-        raise e
-    finally:
-        sqe = ring.get_sqe()
-        sqe.prep_accept(sfd)
-        sqe.set_data((accepted, sfd))
-
-        ring.submit()
-
-def closed(fd, cqe=None):
+def accept(sfd):
+    # armed once, keeps accepting until it fails
+    sqe = ring.get_sqe()
+    sqe.prep_multishot_accept(sfd)
+    sqe.set_callback(accepted, sfd)
+
+def accepted(res, sfd):
+    if res < 0:
+        logging.error("error while accept connection: %s", os.strerror(-res))
+        # multishot accept is terminated by an error, arm it again
+        accept(sfd)
+        return
+    sqe = ring.get_sqe()
+    sqe.prep_recv(res, 512)
+    sqe.set_callback(recv, res)
+
+def closed(res, fd):
     logging.info("connection closed: %s", fd)
-    pass
-
 
-def recv(fd, cqe=None):
-    try:
-        ret = cqe.getresult()
 
-        if not ret:
-            logging.info("closing connection: %s", fd)
-            sqe = ring.get_sqe()
-            sqe.prep_close(fd)
-            sqe.set_data((closed, fd))
-            ring.submit()
-            logging.info("prepare finished closing connection: %s", fd)
-            return
+def recv(res, fd):
+    if isinstance(res, int):
+        logging.error("error while recv peer: %s", os.strerror(-res))
+        res = b""
 
+    if not res:
+        logging.info("closing connection: %s", fd)
         sqe = ring.get_sqe()
-        sqe.prep_send(fd, ret)
-        sqe.set_data((written, fd, ret))
-
+        sqe.prep_close(fd)
+        sqe.set_callback(closed, fd)
+        return
+
+    # echo back and receive again, submitted together when run returns
+    sqe = ring.get_sqe()
+    sqe.prep_send(fd, res)
+    sqe.set_callback(written, fd, res)
+    sqe = ring.get_sqe()
+    sqe.prep_recv(fd, 1024)
+    sqe.set_callback(recv, fd)
+
+
+def written(res, fd, buf):
+    if res < 0:
+        logging.error("error while write peer: %s", os.strerror(-res))
+        return
+    if res < len(buf):
         sqe = ring.get_sqe()
-        sqe.prep_recv(fd, 1024)
-        sqe.set_data((recv, fd))
-        ring.submit()
-
-    except OSError as e:
-        logging.exception("error while recv peer")
-        raise e
-
-
-
-def written(fd, buf, cqe=None):
-    try:
-        res = cqe.getresult()
-        l = len(buf)
-        if l < res:
-            sqe = ring.get_sqe()
-            sqe.prep_send(fd, buf[res:])
-            sqe.set_data((written, fd, buf[res:]))
-            ring.submit()
-        logging.info("write to peer: %s, %s, %s", res, l, fd)
-    except OSError as e:
-        logging.exception("error while write peer")
-        pass
-
-def waiting():
-    cq_ready = ring.cq_ready()
-    sq_ready = ring.sq_ready()
-    if cq_ready:
-        cqes = ring.wait_cqes(cq_ready)
-    else:
-        cqe = ring.wait_cqe()
-        cqes = (cqe, )
-    for cqe in cqes:
-        process_cqe(cqe)
-        ring.cqe_seen(cqe)
-    # cqe = ring.wait_cqe()
-    # process_cqe(cqe)
-    # ring.cqe_seen(cqe)
-
-
-def process_cqe(cqe):
-    cb, *args  = cqe.get_data()
-    logging.info("calling cb: %s", cb)
-    if cb and callable(cb):
-        cb(*args, cqe=cqe)
+        sqe.prep_send(fd, buf[res:])
+        sqe.set_callback(written, fd, buf[res:])
+    logging.info("write to peer: %s, %s, %s", res, len(buf), fd)
 
 
 def main():
@@ -107,14 +73,10 @@ def main():
     server = listen_on('127.0.0.1', 8888)
     try:
         with server:
-            sfd = server.fileno()
-            sqe = ring.get_sqe()
-            sqe.prep_accept(sfd)
-            sqe.set_data((accepted, sfd))
-            ring.submit()
-            sqe = None
+            accept(server.fileno())
             while 1:
-                waiting()
+                # completions are dispatched to their callbacks in C
+                ring.run(64)
     finally:
         ring.queue_exit()
 
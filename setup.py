@@ -11,6 +11,8 @@ setup(
     name="py_io_uring",
     version="0.0.1",
     description="Python wrapper liburing, have fun with io_uring and python.",
-    ext_modules = [ext]
+    ext_modules = [ext],
+    package_dir = {'': 'src'},
+    py_modules = ['py_io_uring_asyncio']
 )
 
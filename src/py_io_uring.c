@@ -1,42 +1,735 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pythread.h>
+#include <structmember.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/fs.h>
 #include <liburing.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct SqeObject SqeObject;
+
+// log-linear latency histogram: values below 8ns have a bucket each, every
+// power of two above is split in 8 buckets, so a bucket is within 12.5%.
+#define LATENCY_SUB_BITS 3
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+// largest errno counted by stats, linux errno values are far below it
+#define STATS_ERRNO_MAX 256
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum_ns;
+    unsigned long long min_ns;
+    unsigned long long max_ns;
+    unsigned long long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+// counters of enable_stats, all updated with the GIL held
+typedef struct {
+    unsigned long long submitted[IORING_OP_LAST];
+    unsigned long long completed[IORING_OP_LAST];
+    unsigned long long errors[STATS_ERRNO_MAX]; // indexed by errno
+    unsigned long long enter_calls;
+    unsigned long long sq_full;
+    // allocated by the first final completion of an opcode
+    LatencyHistogram *latency[IORING_OP_LAST];
+} IoUringStats;
 
 typedef struct {
     PyObject_HEAD
     struct io_uring *ring;
-    PyObject *wait_submit;
+    // slab of Sqe objects allocated by queue_init, sqe user_data is the
+    // slot index, a slot is recycled once its completion has been seen.
+    SqeObject **slots;
+    unsigned nslots;
+    unsigned *free_slots; // stack of free slot index
+    unsigned nfree;
+    unsigned generation; // distinguish reuses of a slot in user_data
+    // stands for cqes whose user_data is none of our slots, such as a
+    // message from another process, they are reported without data.
+    SqeObject *foreign;
+    // we cache unsubmited slots to properly set sqe data field,
+    // so that we can get related sqe object when wait cqe
+    unsigned *wait_submit;
+    unsigned nwait_submit;
+    void *buffer_pool; // registered BufferPool, cleared when it is closed
+    IoUringStats *stats; // NULL unless enable_stats
+    void *timers; // TimerWheel bound to this ring, cleared when it is closed
+    // the GIL is released while we are in io_uring_enter, so liburing's
+    // submission and completion side bookkeeping need their own locks.
+    PyThread_type_lock sq_lock; // held by get_sqe and submit
+    PyThread_type_lock cq_lock; // held by the thread waiting for completions
 } IoUringObject;
 
-typedef struct {
+struct SqeObject {
     PyObject_HEAD
-    struct io_uring_sqe *sqe;
+    struct io_uring_sqe *sqe; // NULL once submitted
+    __u64 user_data; // slot index in lower 32 bits, generation in upper
     int fd;
     int error;
     int operation;
     PyObject *allocated_buffer; // buffer create by us
-    Py_buffer *user_buffer; // buffer user passed in as parameter
+    Py_buffer user_buffer; // buffer user passed in as parameter
+    // readv/writev buffers, iovecs and views share one allocation
+    struct iovec *iovecs;
+    Py_buffer *iov_views;
+    unsigned niov;
+    // socket address of connect and accept, kept inline so that these
+    // operations need no allocation. addrlen is 0 when nothing is stored.
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int accept_mode; // ACCEPT_* mode of the last prep_accept
     PyObject *data; // any object, can be reached cqe.get_data()
-    void *cqeobj; // store related cqe pointer, keep single instance refer by user.
-} SqeObject;
+    PyObject *callback; // called by IoUring.run, NULL when not set
+    // prep_send_msg keeps target ring in allocated_buffer and the slot
+    // reserved there for the message here.
+    __u64 msg_user_data;
+    PyObject *cbargs; // tuple of extra callback arguments, NULL when none
+    unsigned long long submit_ns; // submit time when stats are enabled, else 0
+    void *cqeobj; // live Cqe objects of this sqe, linked by next without refs
+};
 
 typedef struct {
     PyObject_HEAD
     struct io_uring_cqe *cqe;
     SqeObject *sqeobj;
+    // copied out of the completion queue, the cqe slot may be reused
+    // by kernel once any thread has marked it seen.
+    int res;
+    unsigned flags;
     bool seen;
+    PyObject *result; // cache of getresult() which owns a provided buffer
+    void *next; // a multishot sqe may have several cqes alive at once
 } CqeObject;
 
-static PyTypeObject SqeType, CqeType, IoUringType;
+typedef struct {
+    PyObject_HEAD
+    IoUringObject *ring;
+    char *base; // page aligned memory of all buffers, NULL once closed
+    Py_ssize_t size; // size of each buffer, multiple of page size
+    unsigned nbufs;
+    Py_ssize_t exports; // number of buffer views handed out
+} BufferPoolObject;
+
+typedef struct {
+    PyObject_HEAD
+    IoUringObject *ring;
+    struct io_uring_buf_ring *br; // shared with kernel, NULL once closed
+    char *base; // memory of all buffers
+    Py_ssize_t size; // size of each buffer
+    unsigned nbufs; // power of 2
+    int bgid;
+    Py_ssize_t outstanding; // buffers selected by kernel and not returned yet
+} BufferRingObject;
+
+// a buffer selected by kernel from BufferRing, returned on release()
+typedef struct {
+    PyObject_HEAD
+    BufferRingObject *bufring; // NULL once released
+    char *buf;
+    Py_ssize_t len;
+    unsigned short bid;
+    Py_ssize_t exports;
+} ProvidedBufferObject;
+
+static PyTypeObject SqeType, CqeType, IoUringType, BufferPoolType;
+static PyTypeObject BufferRingType, ProvidedBufferType;
+static PyTypeObject StatxResultType, ProxyType, FileStreamType, AlignedBufferType;
+static PyTypeObject RingGroupType;
+static PyTypeObject TimerWheelType;
+
+// operations of one Proxy round, in the order they are linked
+enum {
+    PROXY_POLL_IN,
+    PROXY_SPLICE_IN,
+    PROXY_POLL_OUT,
+    PROXY_SPLICE_OUT,
+    PROXY_OPS,
+};
+
+// moves data from src to dst through a pipe with linked splice pairs,
+// completions are consumed by harvest which queues the next round.
+typedef struct {
+    PyObject_HEAD
+    IoUringObject *ring;
+    int src;
+    int dst;
+    int pipefd[2]; // -1 once finished
+    int pipe_size;
+    int inpipe; // bytes spliced into pipe but not out yet
+    long long transferred; // bytes spliced to dst
+    int error; // negative errno which stopped the proxy
+    bool eof;
+    bool poll_in; // src is nonblocking and was drained, poll it first
+    bool poll_out; // dst is nonblocking and was full, poll it first
+    bool done;
+    unsigned pending; // operations of current round not completed yet
+    __u64 user_data[PROXY_OPS];
+} ProxyObject;
+
+enum {
+    CHUNK_IDLE, // not queued, or handed out to user
+    CHUNK_READING, // a read into it is in kernel
+    CHUNK_READY,
+};
+
+typedef struct {
+    __u64 user_data; // of the read in kernel
+    long long offset;
+    Py_ssize_t len; // bytes wanted
+    Py_ssize_t filled; // bytes read so far
+    int error; // negative errno
+    int state;
+} FileStreamChunk;
+
+// reads a file with depth chunks in flight, chunks are handed out in
+// file order and their buffers are queued again once user is done.
+typedef struct {
+    PyObject_HEAD
+    IoUringObject *ring;
+    int fd;
+    char *base; // depth buffers of chunk_size
+    Py_ssize_t chunk_size;
+    unsigned depth;
+    long long offset; // where next queued chunk reads from
+    long long end; // stop at this offset, -1 for end of file
+    FileStreamChunk *chunks;
+    unsigned head; // chunk handed out next
+    bool eof; // end of file is seen, queue no more chunks
+    bool started;
+    bool finished;
+    bool handed; // chunk before head is handed out and not queued again
+    PyObject *view; // memoryview of chunk handed out last
+    char *export_buf; // chunk exported by getbuffer, only set by iternext
+    Py_ssize_t export_len;
+    Py_ssize_t exports; // views of handed out chunk still alive
+} FileStreamObject;
+
+// acquire lock without blocking other python threads while it is contended
+#define ACQUIRE_LOCK(lock) do { \
+    if (!PyThread_acquire_lock((lock), 0)) { \
+        Py_BEGIN_ALLOW_THREADS \
+        PyThread_acquire_lock((lock), 1); \
+        Py_END_ALLOW_THREADS \
+    } \
+} while (0)
+
+#define RELEASE_LOCK(lock) PyThread_release_lock(lock)
+
+// number of cqes harvested in one batch without heap allocation
+#define CQE_BATCH_STACK 64
+
+// a completion harvested for IoUring.run or an expired timer, its callback
+// is called after the cq has been advanced. all members are new references,
+// result is NULL for timers.
+typedef struct {
+    PyObject *callback;
+    PyObject *args;
+    PyObject *result;
+} PendingCall;
+
+// page aligned memory for O_DIRECT, length is a multiple of alignment
+typedef struct {
+    PyObject_HEAD
+    char *buf;
+    Py_ssize_t size;
+    Py_ssize_t alignment; // unit of address, length and offset of I/O on it
+    Py_ssize_t exports;
+} AlignedBufferObject;
+
+// rings sharing the io-wq worker pool of the first one
+typedef struct {
+    PyObject_HEAD
+    PyObject *rings; // tuple of IoUring
+} RingGroupObject;
+
+// hierarchical timer wheel, a slot of level n spans 64^n ticks
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 6
+#define TIMER_NONE UINT_MAX // end of a list of timer nodes
+#define TIMER_NEVER ULLONG_MAX
+
+typedef struct {
+    unsigned long long expires; // tick the timer is due
+    PyObject *callback; // NULL while the node is free
+    PyObject *args; // tuple of extra arguments, NULL when none
+    unsigned prev;
+    unsigned next; // next free node while the node is free
+    unsigned generation; // upper half of the handle returned by add
+    unsigned list; // level * TIMER_SLOTS + slot
+} TimerNode;
+
+typedef struct {
+    PyObject_HEAD
+    IoUringObject *ring; // NULL once closed
+    unsigned long long resolution_ns;
+    unsigned long long start_ns; // monotonic time of tick 0
+    unsigned long long tick; // next tick to be processed
+    unsigned heads[TIMER_LEVELS * TIMER_SLOTS];
+    unsigned long long occupied[TIMER_LEVELS]; // bitmap of non-empty slots
+    TimerNode *nodes;
+    unsigned nnodes;
+    unsigned free_node;
+    Py_ssize_t count; // pending timers
+    // one kernel timeout in flight wakes the ring at armed_tick
+    bool armed;
+    __u64 armed_user_data;
+    unsigned long long armed_tick;
+    struct __kernel_timespec ts; // read by kernel when timeout is submitted
+    PendingCall *expired; // timers collected by advance, array is reused
+    unsigned nexpired;
+    unsigned expired_size;
+} TimerWheelObject;
+
+static PyObject *Sqe_new(PyTypeObject *type, PyObject *args, PyObject *kwls);
+static PyObject *Cqe_new(PyTypeObject *type, PyObject *args, PyObject *kwlist);
+static void Sqe_reset(SqeObject *self);
+static void IoUring_release_slot(IoUringObject *self, SqeObject *sqeobj);
+static void IoUring_release_exited(IoUringObject *self);
+static void Sqe_reinit_buffer(SqeObject *self);
+static PyObject *Sqe_getresult(SqeObject *self, int res, unsigned flags);
+static void BufferRing_recycle(BufferRingObject *self, unsigned short bid);
+static PyObject *IoUring_get_sqe(IoUringObject *self);
+static PyObject *IoUring_submit(IoUringObject *self);
+static int Sqe_prep_record(SqeObject *self, PyObject *record);
+static bool Proxy_complete(ProxyObject *self, struct io_uring_cqe *cqe);
+static void FileStream_complete(FileStreamObject *self, struct io_uring_cqe *cqe);
+static PyObject *FileStream_new(IoUringObject *ring, PyObject *const *args, Py_ssize_t nargs);
+static int AlignedBuffer_check_io(Py_buffer *view, long long offset);
+static void TimerWheel_complete(TimerWheelObject *self, SqeObject *sqeobj);
+static Py_ssize_t TimerWheel_expire_due(TimerWheelObject *self);
+
+// METH_FASTCALL argument parsing. methods called once per operation take
+// their arguments as a C array, these helpers convert one argument each
+// the way the PyArg_Parse format unit noted on them does, without the
+// argument tuple and the format string interpreter.
+static int
+Args_check(const char *name, Py_ssize_t nargs, Py_ssize_t min, Py_ssize_t max)
+{
+    if (nargs >= min && nargs <= max) {
+        return 1;
+    }
+    if (min == max) {
+        PyErr_Format(PyExc_TypeError, "%s() takes exactly %zd argument%s (%zd given)",
+                name, min, min == 1 ? "" : "s", nargs);
+    } else if (nargs < min) {
+        PyErr_Format(PyExc_TypeError, "%s() takes at least %zd argument%s (%zd given)",
+                name, min, min == 1 ? "" : "s", nargs);
+    } else {
+        PyErr_Format(PyExc_TypeError, "%s() takes at most %zd argument%s (%zd given)",
+                name, max, max == 1 ? "" : "s", nargs);
+    }
+    return 0;
+}
+
+// constructors take positional arguments only, kw is the kwargs dict of
+// tp_new or the kwnames tuple of vectorcall
+static int
+Args_no_keywords(const char *name, PyObject *kw)
+{
+    if (kw == NULL || PyObject_Length(kw) == 0) {
+        return 1;
+    }
+    PyErr_Format(PyExc_TypeError, "%s() takes no keyword arguments", name);
+    return 0;
+}
+
+// "i"
+static inline int
+Arg_int(PyObject *obj, int *out)
+{
+    long v = PyLong_AsLong(obj);
+
+    if (v == -1 && PyErr_Occurred()) {
+        return 0;
+    }
+    if (v > INT_MAX || v < INT_MIN) {
+        PyErr_SetString(PyExc_OverflowError, v > 0
+                ? "signed integer is greater than maximum"
+                : "signed integer is less than minimum");
+        return 0;
+    }
+    *out = (int) v;
+    return 1;
+}
+
+// "I", no overflow checking
+static inline int
+Arg_uint(PyObject *obj, unsigned *out)
+{
+    unsigned long v = PyLong_AsUnsignedLongMask(obj);
+
+    if (v == (unsigned long) -1 && PyErr_Occurred()) {
+        return 0;
+    }
+    *out = (unsigned) v;
+    return 1;
+}
+
+// "L"
+static inline int
+Arg_longlong(PyObject *obj, long long *out)
+{
+    long long v = PyLong_AsLongLong(obj);
+
+    if (v == -1 && PyErr_Occurred()) {
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+// "n"
+static inline int
+Arg_ssize(PyObject *obj, Py_ssize_t *out)
+{
+    Py_ssize_t v = PyNumber_AsSsize_t(obj, PyExc_OverflowError);
+
+    if (v == -1 && PyErr_Occurred()) {
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+// "d"
+static inline int
+Arg_double(PyObject *obj, double *out)
+{
+    double v = PyFloat_AsDouble(obj);
+
+    if (v == -1.0 && PyErr_Occurred()) {
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+// "O!", pos is the zero based position reported in the error
+static int
+Arg_type(PyObject *obj, PyTypeObject *type, const char *name, int pos)
+{
+    if (PyObject_TypeCheck(obj, type)) {
+        return 1;
+    }
+    PyErr_Format(PyExc_TypeError, "%s() argument %d must be %s, not %.50s",
+            name, pos + 1, type->tp_name, Py_TYPE(obj)->tp_name);
+    return 0;
+}
+
+// "y*" with flags 0, "w*" with PyBUF_WRITABLE. view->obj is NULL on failure
+static int
+Arg_buffer(PyObject *obj, Py_buffer *view, int flags, const char *name, int pos)
+{
+    if (PyObject_GetBuffer(obj, view, flags) < 0) {
+        view->obj = NULL;
+        PyErr_Clear();
+        PyErr_Format(PyExc_TypeError, "%s() argument %d must be %s, not %.50s",
+                name, pos + 1, flags & PyBUF_WRITABLE
+                ? "read-write bytes-like object" : "bytes-like object",
+                Py_TYPE(obj)->tp_name);
+        return 0;
+    }
+    return 1;
+}
+
+
+static void
+IoUring_free_slots(IoUringObject *self)
+{
+    SqeObject **slots = self->slots;
+    unsigned nslots = self->nslots;
+
+    self->slots = NULL;
+    self->nslots = self->nfree = self->nwait_submit = 0;
+    for (unsigned i = 0; i < nslots; i++) {
+        Py_XDECREF(slots[i]);
+    }
+    PyMem_Free(slots);
+    PyMem_Free(self->free_slots);
+    PyMem_Free(self->wait_submit);
+    self->free_slots = self->wait_submit = NULL;
+    Py_CLEAR(self->foreign);
+}
+
+static int
+IoUring_init_slots(IoUringObject *self)
+{
+    unsigned nslots = self->ring->sq.ring_entries + self->ring->cq.ring_entries;
+
+    self->slots = PyMem_New(SqeObject *, nslots);
+    self->free_slots = PyMem_New(unsigned, nslots);
+    self->wait_submit = PyMem_New(unsigned, self->ring->sq.ring_entries);
+    if (self->slots == NULL || self->free_slots == NULL || self->wait_submit == NULL) {
+        IoUring_free_slots(self);
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->foreign = (SqeObject *) Sqe_new(&SqeType, NULL, NULL);
+    if (self->foreign == NULL) {
+        IoUring_free_slots(self);
+        return -1;
+    }
+    for (unsigned i = 0; i < nslots; i++) {
+        self->slots[i] = (SqeObject *) Sqe_new(&SqeType, NULL, NULL);
+        if (self->slots[i] == NULL) {
+            self->nslots = i;
+            IoUring_free_slots(self);
+            return -1;
+        }
+        // hand out lower index first
+        self->free_slots[i] = nslots - i - 1;
+    }
+    self->nslots = self->nfree = nslots;
+    return 0;
+}
+
+// more operations are in flight than queue_init expected, double the slab
+static int
+IoUring_grow_slots(IoUringObject *self)
+{
+    unsigned nslots = self->nslots * 2;
+    SqeObject **slots = self->slots;
+    unsigned *free_slots = self->free_slots;
+
+    if (PyMem_Resize(slots, SqeObject *, nslots) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->slots = slots;
+    if (PyMem_Resize(free_slots, unsigned, nslots) == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->free_slots = free_slots;
+    // objects of new slots are created by first use
+    for (unsigned i = self->nslots; i < nslots; i++) {
+        slots[i] = NULL;
+        free_slots[self->nfree++] = i;
+    }
+    self->nslots = nslots;
+    return 0;
+}
+
+static SqeObject *
+IoUring_acquire_slot(IoUringObject *self)
+{
+    unsigned index;
+    SqeObject *sqeobj;
+
+    if (self->nfree == 0 && IoUring_grow_slots(self)) {
+        return NULL;
+    }
+    index = self->free_slots[--self->nfree];
+    sqeobj = self->slots[index];
+    if (sqeobj == NULL) {
+        sqeobj = (SqeObject *) Sqe_new(&SqeType, NULL, NULL);
+        if (sqeobj == NULL) {
+            self->free_slots[self->nfree++] = index;
+            return NULL;
+        }
+        self->slots[index] = sqeobj;
+    }
+    sqeobj->user_data = ((__u64) self->generation++ << 32) | index;
+    return sqeobj;
+}
+
+// a message of prep_send_msg which failed never completes in its target,
+// give back the slot reserved there
+static void
+IoUring_release_msg_slot(SqeObject *sqeobj)
+{
+    IoUringObject *target = (IoUringObject *) sqeobj->allocated_buffer;
+    unsigned index = (unsigned) sqeobj->msg_user_data;
+
+    if (target->slots != NULL && index < target->nslots
+            && target->slots[index] != NULL
+            && target->slots[index]->user_data == sqeobj->msg_user_data) {
+        IoUring_release_slot(target, target->slots[index]);
+    }
+}
+
+// operation of this slot has completed, make the slot available again
+static void
+IoUring_release_slot(IoUringObject *self, SqeObject *sqeobj)
+{
+    unsigned index = (unsigned) sqeobj->user_data;
+
+    if (sqeobj == self->foreign) {
+        return;
+    }
+    if (sqeobj->operation == IORING_OP_MSG_RING && sqeobj->error < 0
+            && sqeobj->allocated_buffer != NULL) {
+        IoUring_release_msg_slot(sqeobj);
+    }
+    if (Py_REFCNT(sqeobj) == 1) {
+        Sqe_reset(sqeobj);
+    } else {
+        // user still refers to it, leave the object to user
+        // and create another one for this slot when needed.
+        self->slots[index] = NULL;
+        sqeobj->sqe = NULL;
+        Py_DECREF(sqeobj);
+    }
+    self->free_slots[self->nfree++] = index;
+}
+
+static inline SqeObject *
+IoUring_cqe_sqeobj(IoUringObject *self, struct io_uring_cqe *cqe)
+{
+    unsigned index = (unsigned) cqe->user_data;
+    SqeObject *sqeobj;
+
+    if (index < self->nslots) {
+        sqeobj = self->slots[index];
+        if (sqeobj != NULL && sqeobj->user_data == cqe->user_data) {
+            return sqeobj;
+        }
+    }
+    return self->foreign;
+}
+
+// find the live Cqe object created for a cqe still in completion queue
+static inline CqeObject *
+Sqe_find_cqe(SqeObject *sqeobj, struct io_uring_cqe *cqe)
+{
+    CqeObject *cqeobj = (CqeObject *) sqeobj->cqeobj;
+
+    while (cqeobj != NULL && cqeobj->cqe != cqe) {
+        cqeobj = (CqeObject *) cqeobj->next;
+    }
+    return cqeobj;
+}
+
+static inline void
+Sqe_unlink_cqe(SqeObject *sqeobj, CqeObject *cqeobj)
+{
+    void **link = &sqeobj->cqeobj;
+
+    while (*link != NULL && *link != cqeobj) {
+        link = &((CqeObject *) *link)->next;
+    }
+    if (*link != NULL) {
+        *link = cqeobj->next;
+        cqeobj->next = NULL;
+    }
+}
+
+static inline unsigned long long
+Stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline unsigned
+Latency_bucket(unsigned long long ns)
+{
+    unsigned msb;
+
+    if (ns < (1 << LATENCY_SUB_BITS)) {
+        return ns;
+    }
+    msb = 63 - __builtin_clzll(ns);
+    return ((msb - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+        | ((ns >> (msb - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1));
+}
+
+// largest value falling into bucket
+static unsigned long long
+Latency_bucket_max(unsigned bucket)
+{
+    unsigned shift;
+
+    if (bucket < (1 << LATENCY_SUB_BITS)) {
+        return bucket;
+    }
+    shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    return ((((unsigned long long) bucket & ((1 << LATENCY_SUB_BITS) - 1))
+            + (1 << LATENCY_SUB_BITS) + 1) << shift) - 1;
+}
+
+// account a completion, now is taken once per batch of completions
+static void
+IoUring_stats_complete(IoUringObject *self, SqeObject *sqeobj, int res,
+        unsigned flags, unsigned long long now)
+{
+    IoUringStats *stats = self->stats;
+    LatencyHistogram *hist;
+    int op = sqeobj->operation;
+    unsigned long long ns;
+
+    if (res < 0 && -res < STATS_ERRNO_MAX) {
+        stats->errors[-res]++;
+    }
+    if (sqeobj == self->foreign || op < 0 || op >= IORING_OP_LAST) {
+        return;
+    }
+    stats->completed[op]++;
+    // latency is up to the final completion of multishot operations,
+    // operations submitted before stats were enabled have no submit time
+    if ((flags & IORING_CQE_F_MORE) || sqeobj->submit_ns == 0) {
+        return;
+    }
+    hist = stats->latency[op];
+    if (hist == NULL) {
+        hist = stats->latency[op] = PyMem_Calloc(1, sizeof(LatencyHistogram));
+        if (hist == NULL) {
+            return; // histograms are best effort
+        }
+    }
+    ns = now > sqeobj->submit_ns ? now - sqeobj->submit_ns : 0;
+    if (hist->count == 0 || ns < hist->min_ns) {
+        hist->min_ns = ns;
+    }
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+    hist->count++;
+    hist->sum_ns += ns;
+    hist->buckets[Latency_bucket(ns)]++;
+}
 
+static void
+IoUring_free_stats(IoUringObject *self)
+{
+    if (self->stats == NULL) {
+        return;
+    }
+    for (unsigned i = 0; i < IORING_OP_LAST; i++) {
+        PyMem_Free(self->stats->latency[i]);
+    }
+    PyMem_Free(self->stats);
+    self->stats = NULL;
+}
 
 // IoUringObject methods definitions
 static void IoUring_dealloc(IoUringObject *self)
 {
-    Py_XDECREF((PyObject *) self->wait_submit);
+    // buffers of in flight operations must outlive the ring
+    if (self->slots != NULL) {
+        io_uring_queue_exit(self->ring);
+        IoUring_release_exited(self);
+    }
+    IoUring_free_stats(self);
+    if (self->sq_lock) {
+        PyThread_free_lock(self->sq_lock);
+    }
+    if (self->cq_lock) {
+        PyThread_free_lock(self->cq_lock);
+    }
     PyMem_Free(self->ring);
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
@@ -45,9 +738,6 @@ static PyObject *
 IoUring_new(PyTypeObject *type, PyObject *args, PyObject *kwargs){
     IoUringObject *self;
     struct io_uring *ring;
-    // we cache unsubmited entries to properly set sqe data field,
-    // so that we can get related sqe object when wait cqe
-    PyObject *wait_submit;
 
     self = (IoUringObject *) (type->tp_alloc(type, 0));
 
@@ -58,10 +748,10 @@ IoUring_new(PyTypeObject *type, PyObject *args, PyObject *kwargs){
         } else {
             goto error;
         }
-        wait_submit = PyList_New(0);
-        if (wait_submit) {
-            self->wait_submit = wait_submit;
-        } else {
+        self->sq_lock = PyThread_allocate_lock();
+        self->cq_lock = PyThread_allocate_lock();
+        if (self->sq_lock == NULL || self->cq_lock == NULL) {
+            PyErr_SetString(PyExc_MemoryError, "unable to allocate lock");
             goto error;
         }
     }
@@ -82,39 +772,121 @@ IoUring_get_sqe(IoUringObject *self)
     SqeObject *sqeobj;
     struct io_uring_sqe *sqe;
 
-    sqeobj = (SqeObject *) PyObject_CallObject((PyObject *) &SqeType, NULL);
-    if (sqeobj) {
-        // TODO: get_sqe may got queue full error
-        sqe = io_uring_get_sqe(self->ring);
-        sqeobj->sqe = sqe;
-        if (PyList_Append(self->wait_submit, (PyObject *) sqeobj)) {
-            Py_DECREF(sqeobj);
-            return NULL;
+    sqeobj = IoUring_acquire_slot(self);
+    if (sqeobj == NULL) {
+        return NULL;
+    }
+    // submit may be running in another thread without the GIL,
+    // wait for it to finish before touching the submission queue.
+    ACQUIRE_LOCK(self->sq_lock);
+    sqe = io_uring_get_sqe(self->ring);
+    if (sqe == NULL) {
+        RELEASE_LOCK(self->sq_lock);
+        self->free_slots[self->nfree++] = (unsigned) sqeobj->user_data;
+        if (self->stats != NULL) {
+            self->stats->sq_full++;
         }
+        errno = EBUSY;
+        return PyErr_SetFromErrno(PyExc_OSError);
     }
+    sqeobj->sqe = sqe;
+    self->wait_submit[self->nwait_submit++] = (unsigned) sqeobj->user_data;
+    RELEASE_LOCK(self->sq_lock);
+    Py_INCREF(sqeobj);
     return (PyObject *)sqeobj;
 }
 
+static PyObject *
+IoUring_queue_init_impl(IoUringObject *self, unsigned entries, struct io_uring_params *params)
+{
+    int ret;
+
+    ret = io_uring_queue_init_params(entries, self->ring, params);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (IoUring_init_slots(self)) {
+        io_uring_queue_exit(self->ring);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 PyDoc_STRVAR(
         queue_init_doc,
         "queue_init(entries[, flag]) -> None\n\n"
         "setup an context for perfoming asynchronous IO.");
 
 static PyObject *
-IoUring_queue_init(IoUringObject *self, PyObject *args)
+IoUring_queue_init(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
     int entries;
     unsigned flag = 0;
-    int ret = 0;
-    if (!PyArg_ParseTuple(args, "i|I:queue_init", &entries, &flag)) {
+    struct io_uring_params params;
+
+    if (!Args_check("queue_init", nargs, 1, 2)
+            || !Arg_int(args[0], &entries)
+            || (nargs > 1 && !Arg_uint(args[1], &flag))) {
         return NULL;
     }
-    ret = io_uring_queue_init(entries, self->ring, flag);
-    if (ret < 0) {
-        errno = -ret;
-        return PyErr_SetFromErrno(PyExc_OSError);
+    memset(&params, 0, sizeof(params));
+    params.flags = flag;
+    return IoUring_queue_init_impl(self, entries, &params);
+}
+
+PyDoc_STRVAR(
+        queue_init_params_doc,
+        "queue_init_params(entries, flags=0, *, sq_thread_cpu=-1, sq_thread_idle=0,\n"
+        "                  cq_entries=0, wq_fd=-1) -> None\n\n"
+        "setup an context like queue_init with io_uring_params fields.\n"
+        "IORING_SETUP_SQ_AFF, IORING_SETUP_CQSIZE and IORING_SETUP_ATTACH_WQ are\n"
+        "added to flags when sq_thread_cpu, cq_entries or wq_fd are given.\n"
+        "with IORING_SETUP_SINGLE_ISSUER only the thread which submits first may\n"
+        "submit, with IORING_SETUP_DEFER_TASKRUN\n"
+        "completions are only posted while waiting for them, e.g. wait_cqe or drain(1).");
+
+static PyObject *
+IoUring_queue_init_params(IoUringObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"entries", "flags", "sq_thread_cpu", "sq_thread_idle",
+        "cq_entries", "wq_fd", NULL};
+    unsigned entries;
+    int sq_thread_cpu = -1, wq_fd = -1;
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "I|I$iIIi:queue_init_params", kwlist,
+                &entries, &params.flags, &sq_thread_cpu, &params.sq_thread_idle,
+                &params.cq_entries, &wq_fd)) {
+        return NULL;
     }
-    Py_RETURN_NONE;
+    if (sq_thread_cpu >= 0) {
+        params.flags |= IORING_SETUP_SQ_AFF;
+        params.sq_thread_cpu = sq_thread_cpu;
+    }
+    if (params.cq_entries > 0) {
+        params.flags |= IORING_SETUP_CQSIZE;
+    }
+    if (wq_fd >= 0) {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = wq_fd;
+    }
+    return IoUring_queue_init_impl(self, entries, &params);
+}
+
+PyDoc_STRVAR(
+        features_doc,
+        "features() -> int\n\n"
+        "return IORING_FEAT_* bitmask supported by kernel, 0 before queue_init.");
+
+static PyObject *
+IoUring_features(IoUringObject *self)
+{
+    if (self->slots == NULL) {
+        return PyLong_FromLong(0);
+    }
+    return PyLong_FromUnsignedLong(self->ring->features);
 }
 
 PyDoc_STRVAR(
@@ -122,10 +894,37 @@ PyDoc_STRVAR(
         "queue_exit() -> None\n\n"
         "teardown io_uring instance.");
 
+// after io_uring_queue_exit kernel has dropped all in flight operations,
+// release their buffers. called without locks, dropping them may run code.
+static void
+IoUring_release_exited(IoUringObject *self)
+{
+    IoUring_free_slots(self);
+    if (self->timers != NULL) {
+        ((TimerWheelObject *) self->timers)->armed = false;
+    }
+    // and registered buffers along with the ring
+    self->buffer_pool = NULL;
+}
+
 static PyObject *
 IoUring_queue_exit(IoUringObject *self)
 {
+    // ring fd and mappings are stale once exited
+    if (self->slots == NULL) {
+        Py_RETURN_NONE;
+    }
+    // a thread sleeping in wait_cqe would wake up on unmapped rings
+    if (!PyThread_acquire_lock(self->cq_lock, 0)) {
+        PyErr_SetString(PyExc_RuntimeError,
+                "queue_exit() called while another thread is waiting for completions");
+        return NULL;
+    }
+    ACQUIRE_LOCK(self->sq_lock);
     io_uring_queue_exit(self->ring);
+    RELEASE_LOCK(self->sq_lock);
+    RELEASE_LOCK(self->cq_lock);
+    IoUring_release_exited(self);
     Py_RETURN_NONE;
 }
 
@@ -134,71 +933,204 @@ PyDoc_STRVAR(
         "submit() -> int\n\n"
         "submit operations to kernel, return number of sqes submitted.");
 
-static PyObject *
-IoUring_submit(IoUringObject *self)
+// flush prepared sqes to kernel, then wait for wait_nr completions.
+// return number of sqes submitted or negative errno.
+static int
+IoUring_submit_and_wait(IoUringObject *self, unsigned wait_nr)
 {
     SqeObject *sqeobj; 
-    Py_ssize_t nsubmit;
-    nsubmit = PyList_Size(self->wait_submit);
-    for (unsigned int i = 0; i < nsubmit; i++) {
-        sqeobj = (SqeObject *) PyList_GetItem(self->wait_submit, i);
-        io_uring_sqe_set_data(sqeobj->sqe, sqeobj);
-        Py_INCREF(sqeobj);
+    IoUringStats *stats = self->stats;
+    unsigned long long now = 0;
+    int ret;
+
+    // hold sq_lock until io_uring_submit returns, so sqes acquired by other
+    // threads meanwhile are not flushed to kernel without their data set.
+    ACQUIRE_LOCK(self->sq_lock);
+    if (stats != NULL) {
+        now = Stats_now();
+        // liburing skips the syscall with nothing to submit or wait for
+        if (self->nwait_submit || wait_nr) {
+            stats->enter_calls++;
+        }
     }
-    int ret = io_uring_submit(self->ring);
-    if (ret < 0) {
-        errno = -ret;
-        return PyErr_SetFromErrno(PyExc_OSError);
+    for (unsigned i = 0; i < self->nwait_submit; i++) {
+        // slot stays referred by the slab until its cqe is seen
+        sqeobj = self->slots[self->wait_submit[i]];
+        io_uring_sqe_set_data64(sqeobj->sqe, sqeobj->user_data);
+        sqeobj->sqe = NULL;
+        if (stats != NULL) {
+            sqeobj->submit_ns = now;
+            if (sqeobj->operation >= 0 && sqeobj->operation < IORING_OP_LAST) {
+                stats->submitted[sqeobj->operation]++;
+            }
+        }
     }
-    Py_DECREF(self->wait_submit);
-    self->wait_submit = PyList_New(0);
-    Py_RETURN_NONE;
+    self->nwait_submit = 0;
+    Py_BEGIN_ALLOW_THREADS
+    ret = io_uring_submit_and_wait(self->ring, wait_nr);
+    Py_END_ALLOW_THREADS
+    RELEASE_LOCK(self->sq_lock);
+    return ret;
 }
 
 static PyObject *
-IoUring_wait_cqe_nr_impl(IoUringObject *self, unsigned wait_nr)
+IoUring_submit(IoUringObject *self)
 {
-    struct io_uring_cqe *cqes;
-    struct io_uring_cqe *cqe;
-    int ret;
-    PyObject *rlist;
-    CqeObject *cqeobj;
-    SqeObject *sqeobj;
-
-    ret = io_uring_wait_cqe_nr(self->ring, &cqes, wait_nr);
+    int ret = IoUring_submit_and_wait(self, 0);
 
     if (ret < 0) {
         errno = -ret;
         return PyErr_SetFromErrno(PyExc_OSError);
     }
-    rlist = PyList_New(wait_nr);
-    for (unsigned i = 0; i < wait_nr; i++) {
-        cqe = cqes + i;
-        sqeobj = (SqeObject *) cqe->user_data;
-        if (sqeobj->cqeobj == NULL) {
-            // we store cqe instance in sqeobj->cqeobj without incref
-            // to make sure only one instance has been initialized
-            // during user keep a reference pointer to cqe created last time.
-            // and avoid memory leak. but if last one has been gc,
-            // we create a new one.
-            cqeobj =(CqeObject *) PyObject_CallObject((PyObject *) &CqeType, NULL);
-            cqeobj->cqe = cqe;
-            Py_INCREF(sqeobj);
-            cqeobj->sqeobj = sqeobj;
-            sqeobj->cqeobj = cqeobj;
+    return PyLong_FromLong(ret);
+}
+
+// without IORING_FEAT_EXT_ARG a wait timeout is a timeout sqe counting
+// wait_nr completions. queue it the way liburing does, whose peek skips
+// its cqe, but hold sq_lock only while queueing instead of during the
+// whole wait, so other threads keep submitting. return 0 or negative errno.
+static int
+IoUring_queue_wait_timeout(IoUringObject *self, unsigned wait_nr, struct __kernel_timespec *ts)
+{
+    struct io_uring_sqe *sqe;
+    int ret;
+
+    ACQUIRE_LOCK(self->sq_lock);
+    sqe = io_uring_get_sqe(self->ring);
+    if (sqe != NULL) {
+        io_uring_prep_timeout(sqe, ts, wait_nr, 0);
+        io_uring_sqe_set_data64(sqe, LIBURING_UDATA_TIMEOUT);
+    }
+    RELEASE_LOCK(self->sq_lock);
+    if (sqe == NULL) {
+        // make room by submitting what is queued
+        ret = IoUring_submit_and_wait(self, 0);
+        if (ret < 0) {
+            return ret;
+        }
+        return IoUring_queue_wait_timeout(self, wait_nr, ts);
+    }
+    // kernel copies ts when the sqe is submitted
+    ret = IoUring_submit_and_wait(self, 0);
+    return ret < 0 ? ret : 0;
+}
+
+// wait for wait_nr completions with the GIL released. cq head may be
+// advanced by cqe_seen in another thread while we are sleeping in kernel,
+// so the head cqe is peeked again after the GIL is held. return 0 or
+// negative errno with the exception set.
+static int
+IoUring_wait_cqe_nogil(IoUringObject *self, struct io_uring_cqe **cqe_ptr,
+        unsigned wait_nr, struct __kernel_timespec *ts)
+{
+    struct io_uring *ring = self->ring;
+    int ret;
+
+    ACQUIRE_LOCK(self->cq_lock);
+    for (;;) {
+        if (io_uring_cq_ready(ring) >= wait_nr
+                && io_uring_peek_cqe(ring, cqe_ptr) == 0) {
+            ret = 0;
+            break;
+        }
+        if (ts && !(ring->features & IORING_FEAT_EXT_ARG)) {
+            ret = IoUring_queue_wait_timeout(self, wait_nr, ts);
+            if (ret < 0) {
+                errno = -ret;
+                PyErr_SetFromErrno(PyExc_OSError);
+                break;
+            }
+            // expiry of the queued timeout ends the wait from now on
+            ts = NULL;
+        }
+        if (self->stats != NULL) {
+            self->stats->enter_calls++;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        if (ts) {
+            ret = io_uring_wait_cqes(ring, cqe_ptr, wait_nr, ts, NULL);
         } else {
-            cqeobj = (CqeObject *) sqeobj->cqeobj;
-            Py_INCREF(cqeobj);
+            ret = io_uring_wait_cqe_nr(ring, cqe_ptr, wait_nr);
+        }
+        Py_END_ALLOW_THREADS
+        if (ret == -EINTR) {
+            if (PyErr_CheckSignals()) {
+                break;
+            }
+            continue;
+        }
+        if (ret < 0) {
+            errno = -ret;
+            PyErr_SetFromErrno(PyExc_OSError);
+            break;
+        }
+    }
+    RELEASE_LOCK(self->cq_lock);
+    return ret;
+}
+
+// create Cqe object for a cqe still in completion queue, must hold the GIL.
+static PyObject *
+IoUring_make_cqe(IoUringObject *self, struct io_uring_cqe *cqe)
+{
+    SqeObject *sqeobj = IoUring_cqe_sqeobj(self, cqe);
+    CqeObject *cqeobj = Sqe_find_cqe(sqeobj, cqe);
+
+    if (cqeobj == NULL) {
+        // cqe instances are linked in sqeobj->cqeobj without incref
+        // to make sure only one instance is created for a cqe while
+        // user keeps a reference to it, they unlink themselves when
+        // gc. a multishot sqe may have several cqes ready, marking
+        // all of them seen when cq is advanced past them.
+        cqeobj = (CqeObject *) Cqe_new(&CqeType, NULL, NULL);
+        if (cqeobj == NULL) {
+            return NULL;
         }
-        if (PyList_SetItem(rlist, i, (PyObject *) cqeobj)) {
-            Py_DECREF(cqeobj);
+        cqeobj->cqe = cqe;
+        cqeobj->res = cqe->res;
+        cqeobj->flags = cqe->flags;
+        Py_INCREF(sqeobj);
+        cqeobj->sqeobj = sqeobj;
+        cqeobj->next = sqeobj->cqeobj;
+        sqeobj->cqeobj = cqeobj;
+    } else {
+        Py_INCREF(cqeobj);
+    }
+    return (PyObject *) cqeobj;
+}
+
+static PyObject *
+IoUring_wait_cqe_nr_impl(IoUringObject *self, unsigned wait_nr, struct __kernel_timespec *ts)
+{
+    struct io_uring_cqe *cqe;
+    struct io_uring_cqe **cqes;
+    PyObject *rlist = NULL;
+    PyObject *cqeobj;
+
+    if (IoUring_wait_cqe_nogil(self, &cqe, wait_nr, ts)) {
+        return NULL;
+    }
+    // completion queue is a ring, cqes are not contiguous once it wraps
+    cqes = PyMem_New(struct io_uring_cqe *, wait_nr);
+    if (cqes == NULL) {
+        return PyErr_NoMemory();
+    }
+    wait_nr = io_uring_peek_batch_cqe(self->ring, cqes, wait_nr);
+    rlist = PyList_New(wait_nr);
+    if (rlist == NULL) {
+        goto error;
+    }
+    for (unsigned i = 0; i < wait_nr; i++) {
+        cqeobj = IoUring_make_cqe(self, cqes[i]);
+        if (cqeobj == NULL) {
+            Py_CLEAR(rlist);
             goto error;
         }
+        PyList_SET_ITEM(rlist, i, cqeobj);
     }
-    return rlist;
 error:
-    Py_DECREF(rlist);
-    return NULL;
+    PyMem_Free(cqes);
+    return rlist;
 }
 
 PyDoc_STRVAR(
@@ -207,118 +1139,55 @@ PyDoc_STRVAR(
         "waiting for wait_nr completions, return a list of completed Cqe Object.");
 
 static PyObject *
-IoUring_wait_cqe_nr(IoUringObject *self, PyObject *args)
+IoUring_wait_cqe_nr(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
     unsigned wait_nr = 1;
 
-    if (!PyArg_ParseTuple(args, "I:wait_cqe_nr", &wait_nr)) {
+    if (!Args_check("wait_cqe_nr", nargs, 1, 1)
+            || !Arg_uint(args[0], &wait_nr)) {
         return NULL;
     }
-    return IoUring_wait_cqe_nr_impl(self, wait_nr);
+    return IoUring_wait_cqe_nr_impl(self, wait_nr, NULL);
 }
 
 static PyObject *
-IoUring_wait_cqes(IoUringObject *self, PyObject *args)
+IoUring_wait_cqes(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    struct io_uring *ring = self->ring;
-    struct io_uring_cqe *cqes;
-    struct io_uring_cqe *cqe;
     unsigned wait_nr = 0;
     double timeout = 0;
-    int ret;
-    PyObject *rlist;
-    CqeObject *cqeobj;
-    SqeObject *sqeobj;
+    struct __kernel_timespec ts;
 
-    if (!PyArg_ParseTuple(args, "I|d", &wait_nr, &timeout)) {
+    if (!Args_check("wait_cqes", nargs, 1, 2)
+            || !Arg_uint(args[0], &wait_nr)
+            || (nargs > 1 && !Arg_double(args[1], &timeout))) {
         return NULL;
     }
     if (timeout) {
-        printf("in timeout\n");
-        struct __kernel_timespec ts;
         ts.tv_sec = (long long) timeout;
         ts.tv_nsec = (long long) ((timeout - ts.tv_sec) * 1e9);
-        ret = io_uring_wait_cqes(ring, &cqes, wait_nr, &ts, 0);
-    } else {
-        printf("out timeout\n");
-        ret = io_uring_wait_cqes(ring, &cqes, wait_nr, NULL, 0);
-    }
-
-    if (ret) {
-        errno = -ret;
-        return PyErr_SetFromErrno(PyExc_OSError);
+        return IoUring_wait_cqe_nr_impl(self, wait_nr, &ts);
     }
-
-    rlist = PyList_New(wait_nr);
-    if (!rlist) {
-        printf("going to error init list\n");
-        goto error;
-    }
-    for (unsigned i = 0; i < wait_nr; i++) {
-        cqe = cqes + i;
-        printf("0x%p\n", cqe);
-        if (cqe) {
-        sqeobj = (SqeObject *) cqe->user_data;
-        if (sqeobj->cqeobj == NULL) {
-            // we store cqe instance in sqeobj->cqeobj without incref
-            // to make sure only one instance has been initialized
-            // during user keep a reference pointer to cqe created last time.
-            // and avoid memory leak. but if last one has been gc,
-            // we create a new one.
-            cqeobj =(CqeObject *) PyObject_CallObject((PyObject *) &CqeType, NULL);
-            cqeobj->cqe = cqe;
-            Py_INCREF(sqeobj);
-            cqeobj->sqeobj = sqeobj;
-            sqeobj->cqeobj = cqeobj;
-        } else {
-            cqeobj = (CqeObject *) sqeobj->cqeobj;
-            Py_INCREF(cqeobj);
-        }
-        if (PyList_SetItem(rlist, i, (PyObject *) cqeobj)) {
-            Py_DECREF(cqeobj);
-            printf("going to error in list set item\n");
-            goto error;
-        }
-        }
-    }
-    return rlist;
-error:
-    Py_DECREF(rlist);
-    return NULL;
+    return IoUring_wait_cqe_nr_impl(self, wait_nr, NULL);
 }
 
 static inline PyObject *
 IoUring_wait_single_cqe(IoUringObject *self, unsigned wait_nr)
 {
     struct io_uring_cqe *cqe;
-    CqeObject *cqeobj;
-    SqeObject *sqeobj;
     int ret;
-    ret = io_uring_wait_cqe_nr(self->ring, &cqe, wait_nr);
-    if (ret < 0) {
-        errno = -ret;
-        return PyErr_SetFromErrno(PyExc_OSError);
-    }
-    sqeobj = (SqeObject *) cqe->user_data;
-    if (sqeobj->cqeobj == NULL) {
-        cqeobj =(CqeObject *) PyObject_CallObject((PyObject *) &CqeType, NULL);
-        if (cqeobj == NULL) {
+
+    if (wait_nr) {
+        if (IoUring_wait_cqe_nogil(self, &cqe, wait_nr, NULL)) {
             return NULL;
         }
-        cqeobj->cqe = cqe;
-        Py_INCREF(sqeobj);
-        cqeobj->sqeobj = sqeobj;
-        sqeobj->cqeobj = cqeobj;
     } else {
-        cqeobj = (CqeObject *) sqeobj->cqeobj;
-        Py_INCREF(cqeobj);
-    }
-    if (cqeobj == NULL) {
-        return NULL;
+        ret = io_uring_peek_cqe(self->ring, &cqe);
+        if (ret < 0) {
+            errno = -ret;
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
     }
-    cqeobj->cqe = cqe;
-    cqeobj->sqeobj = (SqeObject *) cqe->user_data;
-    return (PyObject *) cqeobj;
+    return IoUring_make_cqe(self, cqe);
 }
 
 PyDoc_STRVAR(
@@ -350,23 +1219,423 @@ PyDoc_STRVAR(
         "mark this Cqe Object as processed. must be called.");
 
 static PyObject *
-IoUring_cqe_seen(IoUringObject *self, PyObject *args)
+IoUring_cqe_seen(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
     CqeObject *cqe;
-    if (!PyArg_ParseTuple(args, "O:cqe_seen", &cqe)) {
+    unsigned index;
+
+    if (!Args_check("cqe_seen", nargs, 1, 1)
+            || !Arg_type(args[0], &CqeType, "cqe_seen", 0)) {
+        return NULL;
+    }
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    cqe = (CqeObject *) args[0];
+    // an unseen cqe keeps the slot of its sqe, unless it is foreign
+    index = (unsigned) cqe->sqeobj->user_data;
+    if (!cqe->seen && cqe->sqeobj != self->foreign
+            && (index >= self->nslots || self->slots[index] != cqe->sqeobj)) {
+        PyErr_SetString(PyExc_ValueError, "cqe belongs to another ring");
         return NULL;
     }
     if (!cqe->seen) {
-        // because we incref sqeobj when we are doing io_uring submit
-        // so we should decref when related cqe has been processed
-        // after cqe_seen this cqe would never be created by wait_cqe
+        // after cqe_seen this cqe would never be created by wait_cqe,
+        // so the slot of related sqe can be reused.
+        if (self->stats != NULL) {
+            IoUring_stats_complete(self, cqe->sqeobj, cqe->res, cqe->flags, Stats_now());
+        }
         io_uring_cqe_seen(self->ring, cqe->cqe);
         cqe->seen = true;
-        Py_DECREF(cqe->sqeobj);
+        if (cqe->res < 0) {
+            cqe->sqeobj->error = cqe->res;
+        }
+        if ((cqe->flags & IORING_CQE_F_BUFFER) && cqe->result == NULL) {
+            // nobody took the provided buffer by getresult, give it back
+            BufferRing_recycle((BufferRingObject *) cqe->sqeobj->allocated_buffer,
+                    cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+        Sqe_unlink_cqe(cqe->sqeobj, cqe);
+        if (Py_IS_TYPE(cqe->sqeobj->data, &TimerWheelType)) {
+            TimerWheel_complete((TimerWheelObject *) cqe->sqeobj->data, cqe->sqeobj);
+        }
+        // multishot operation keeps its slot until the last cqe
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            IoUring_release_slot(self, cqe->sqeobj);
+        }
     }
     Py_RETURN_NONE;
 }
 
+// convert up to max ready cqes into (data, res, flags) tuples and mark
+// them seen with a single cq advance. res is the same as Cqe.getresult()
+// returns, except that a failed operation gives the negative errno.
+// when calls is not NULL, completions of sqes with a callback are stored
+// there instead, it must have room for max entries. entries stored are
+// owned by caller even when NULL is returned.
+// when a cqe fails to convert, harvest stops before it and returns what
+// it has, the next call raises. a failing cqe first in the batch is
+// consumed, so that the error is not raised forever.
+static PyObject *
+IoUring_harvest(IoUringObject *self, unsigned max, PendingCall *calls, unsigned *ncalls)
+{
+    struct io_uring_cqe *stack_cqes[CQE_BATCH_STACK];
+    SqeObject *stack_sqeobjs[CQE_BATCH_STACK];
+    unsigned stack_flags[CQE_BATCH_STACK];
+    struct io_uring_cqe **cqes = stack_cqes;
+    SqeObject **sqeobjs = stack_sqeobjs;
+    unsigned *flags = stack_flags;
+    struct io_uring_cqe *cqe;
+    SqeObject *sqeobj;
+    CqeObject *cqeobj;
+    ProxyObject *proxy;
+    PyObject *rlist = NULL, *item, *res, *flagsobj;
+    PyObject *exc_type = NULL, *exc_value = NULL, *exc_tb = NULL;
+    unsigned i, count, nitems = 0, ncalls0 = calls != NULL ? *ncalls : 0;
+    bool taken = false; // failing cqe has had side effects
+
+    count = io_uring_cq_ready(self->ring);
+    if (max > count) {
+        max = count;
+    }
+    if (max > CQE_BATCH_STACK) {
+        cqes = PyMem_New(struct io_uring_cqe *, max);
+        sqeobjs = PyMem_New(SqeObject *, max);
+        flags = PyMem_New(unsigned, max);
+        if (cqes == NULL || sqeobjs == NULL || flags == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+    }
+    count = io_uring_peek_batch_cqe(self->ring, cqes, max);
+    rlist = PyList_New(count);
+    if (rlist == NULL) {
+        goto done;
+    }
+    for (i = 0; i < count; i++) {
+        cqe = cqes[i];
+        sqeobj = IoUring_cqe_sqeobj(self, cqe);
+        sqeobjs[i] = sqeobj;
+        flags[i] = cqe->flags;
+        if (cqe->res < 0) {
+            sqeobj->error = cqe->res;
+        }
+        if (Py_IS_TYPE(sqeobj->data, &ProxyType)) {
+            proxy = (ProxyObject *) sqeobj->data;
+            // only the completion of the whole transfer is reported
+            if (!Proxy_complete(proxy, cqe)) {
+                continue;
+            }
+            item = Py_BuildValue("(OLI)", proxy,
+                    proxy->error ? (long long) proxy->error : proxy->transferred, 0);
+            if (item == NULL) {
+                // proxy has taken the completion, it is not seen again
+                taken = true;
+                goto failed;
+            }
+            PyList_SET_ITEM(rlist, nitems++, item);
+            continue;
+        }
+        if (Py_IS_TYPE(sqeobj->data, &FileStreamType)) {
+            // left behind others when the stream collected it
+            FileStream_complete((FileStreamObject *) sqeobj->data, cqe);
+            continue;
+        }
+        if (Py_IS_TYPE(sqeobj->data, &TimerWheelType)) {
+            // timers are expired by IoUring.run or TimerWheel.expire
+            TimerWheel_complete((TimerWheelObject *) sqeobj->data, sqeobj);
+            continue;
+        }
+        // allocate item before converting, a dropped provided buffer
+        // would be given back while its cqe is still in queue
+        item = flagsobj = NULL;
+        if (calls == NULL || sqeobj->callback == NULL) {
+            item = PyTuple_New(3);
+            flagsobj = PyLong_FromUnsignedLong(cqe->flags);
+            if (item == NULL || flagsobj == NULL) {
+                Py_XDECREF(item);
+                Py_XDECREF(flagsobj);
+                goto failed;
+            }
+        }
+        cqeobj = Sqe_find_cqe(sqeobj, cqe);
+        if (cqe->res < 0) {
+            res = PyLong_FromLong(cqe->res);
+        } else if (cqeobj != NULL && cqeobj->result != NULL) {
+            // converted by Cqe.getresult() already, may own a provided buffer
+            res = cqeobj->result;
+            Py_INCREF(res);
+        } else {
+            res = Sqe_getresult(sqeobj, cqe->res, cqe->flags);
+        }
+        if (res == NULL) {
+            Py_XDECREF(item);
+            Py_XDECREF(flagsobj);
+            goto failed;
+        }
+        if (calls != NULL && sqeobj->callback != NULL) {
+            Py_INCREF(sqeobj->callback);
+            Py_XINCREF(sqeobj->cbargs);
+            calls[*ncalls].callback = sqeobj->callback;
+            calls[*ncalls].args = sqeobj->cbargs;
+            calls[*ncalls].result = res;
+            (*ncalls)++;
+            continue;
+        }
+        Py_INCREF(sqeobj->data);
+        PyTuple_SET_ITEM(item, 0, sqeobj->data);
+        PyTuple_SET_ITEM(item, 1, res);
+        PyTuple_SET_ITEM(item, 2, flagsobj);
+        PyList_SET_ITEM(rlist, nitems++, item);
+    }
+    goto advance;
+failed:
+    if (nitems > 0 || (calls != NULL && *ncalls > ncalls0)) {
+        // return what is converted, the failing cqe raises next time
+        count = i;
+        if (taken) {
+            count++;
+            PyErr_WriteUnraisable(sqeobjs[i]->data);
+        } else {
+            PyErr_Clear();
+        }
+        goto advance;
+    }
+    PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+    count = i + 1;
+    cqeobj = Sqe_find_cqe(sqeobjs[i], cqes[i]);
+    if (!taken && (flags[i] & IORING_CQE_F_BUFFER)
+            && (cqeobj == NULL || cqeobj->result == NULL)) {
+        // no provided buffer object took the buffer, give it back
+        BufferRing_recycle((BufferRingObject *) sqeobjs[i]->allocated_buffer,
+                flags[i] >> IORING_CQE_BUFFER_SHIFT);
+    }
+advance:
+    // items of swallowed and callback completions were never set
+    Py_SET_SIZE(rlist, nitems);
+    if (self->stats != NULL) {
+        unsigned long long now = Stats_now();
+
+        for (i = 0; i < count; i++) {
+            IoUring_stats_complete(self, sqeobjs[i], cqes[i]->res, flags[i], now);
+        }
+    }
+    io_uring_cq_advance(self->ring, count);
+    // recycle slots only after cq is advanced, since dropping
+    // buffers and data may run arbitrary code which touches the ring.
+    for (i = 0; i < count; i++) {
+        cqeobj = Sqe_find_cqe(sqeobjs[i], cqes[i]);
+        if (cqeobj != NULL) {
+            cqeobj->seen = true;
+            Sqe_unlink_cqe(sqeobjs[i], cqeobj);
+        }
+        // multishot operation keeps its slot until the last cqe
+        if (!(flags[i] & IORING_CQE_F_MORE)) {
+            IoUring_release_slot(self, sqeobjs[i]);
+        }
+    }
+    if (exc_type != NULL) {
+        Py_CLEAR(rlist);
+        PyErr_Restore(exc_type, exc_value, exc_tb);
+    }
+done:
+    if (cqes != stack_cqes) {
+        PyMem_Free(cqes);
+        PyMem_Free(sqeobjs);
+        PyMem_Free(flags);
+    }
+    return rlist;
+}
+
+PyDoc_STRVAR(
+        peek_batch_doc,
+        "peek_batch(max) -> List[Tuple[data, res, flags]]\n\n"
+        "harvest at most max completions without waiting, mark them seen at once.\n"
+        "res is what Cqe.getresult() would return, or negative errno on failure.");
+
+static PyObject *
+IoUring_peek_batch(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    unsigned max;
+
+    if (!Args_check("peek_batch", nargs, 1, 1)
+            || !Arg_uint(args[0], &max)) {
+        return NULL;
+    }
+    return IoUring_harvest(self, max, NULL, NULL);
+}
+
+PyDoc_STRVAR(
+        drain_doc,
+        "drain([wait_nr]) -> List[Tuple[data, res, flags]]\n\n"
+        "waiting for wait_nr completions, then harvest all completions like peek_batch.\n"
+        "Proxy operations are driven here, only their final completion is returned.\n"
+        "reads of stream_file are never returned.");
+
+static PyObject *
+IoUring_drain(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    struct io_uring_cqe *cqe;
+    unsigned wait_nr = 0;
+
+    if (!Args_check("drain", nargs, 0, 1)
+            || (nargs > 0 && !Arg_uint(args[0], &wait_nr))) {
+        return NULL;
+    }
+    if (wait_nr && IoUring_wait_cqe_nogil(self, &cqe, wait_nr, NULL)) {
+        return NULL;
+    }
+    return IoUring_harvest(self, io_uring_cq_ready(self->ring), NULL, NULL);
+}
+
+// arguments of a callback up to this many are passed from the stack
+#define CALLBACK_STACK_ARGS 8
+
+// call callback(result, *args) of a harvested completion, or callback(*args)
+// of a timer, and release it
+static PyObject *
+PendingCall_call(PendingCall *call)
+{
+    PyObject *stack_args[CALLBACK_STACK_ARGS], **argv = stack_args, *ret;
+    Py_ssize_t n = call->args ? PyTuple_GET_SIZE(call->args) : 0;
+    Py_ssize_t skip = call->result == NULL;
+
+    if (n >= CALLBACK_STACK_ARGS) {
+        argv = PyMem_New(PyObject *, n + 1);
+    }
+    if (argv == NULL) {
+        ret = PyErr_NoMemory();
+    } else {
+        argv[0] = call->result;
+        for (Py_ssize_t i = 0; i < n; i++) {
+            argv[i + 1] = PyTuple_GET_ITEM(call->args, i);
+        }
+        ret = PyObject_Vectorcall(call->callback, argv + skip, n + 1 - skip, NULL);
+    }
+    if (argv != stack_args) {
+        PyMem_Free(argv);
+    }
+    Py_DECREF(call->callback);
+    Py_XDECREF(call->args);
+    Py_XDECREF(call->result);
+    return ret;
+}
+
+PyDoc_STRVAR(
+        run_doc,
+        "run(max_events[, timeout]) -> List[Tuple[data, res, flags]]\n\n"
+        "submit prepared sqes, wait up to timeout seconds for a completion, forever\n"
+        "when timeout is omitted or None, then handle up to max_events completions.\n"
+        "callback of an sqe set by Sqe.set_callback is called as callback(res, *args),\n"
+        "res is converted like Cqe.getresult() or a negative errno on failure. sqes\n"
+        "prepared by callbacks are submitted at once before returning. completions\n"
+        "without callback are returned the way drain does. timers of the TimerWheel\n"
+        "of this ring which are due are called next. when callbacks raise, the\n"
+        "rest of the batch is still called and the first exception is raised.\n"
+        "when converting a completion fails, those before it are still handled.");
+
+static PyObject *
+IoUring_run(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PendingCall stack_calls[CQE_BATCH_STACK];
+    PendingCall *calls = stack_calls;
+    PyObject *rlist, *ret, *exc_type = NULL, *exc_value = NULL, *exc_tb = NULL;
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts;
+    unsigned max_events, ncalls = 0;
+    double timeout = -1;
+    int err;
+
+    if (!Args_check("run", nargs, 1, 2)
+            || !Arg_uint(args[0], &max_events)
+            || (nargs > 1 && args[1] != Py_None && !Arg_double(args[1], &timeout))) {
+        return NULL;
+    }
+    if (nargs > 1 && args[1] != Py_None && timeout < 0) {
+        PyErr_SetString(PyExc_ValueError, "timeout must be non-negative");
+        return NULL;
+    }
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    err = IoUring_submit_and_wait(self, 0);
+    if (err < 0) {
+        errno = -err;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (io_uring_cq_ready(self->ring) == 0 && timeout != 0) {
+        if (timeout > 0) {
+            ts.tv_sec = (long long) timeout;
+            ts.tv_nsec = (long long) ((timeout - ts.tv_sec) * 1e9);
+        }
+        err = IoUring_wait_cqe_nogil(self, &cqe, 1, timeout > 0 ? &ts : NULL);
+        if (err == -ETIME) {
+            PyErr_Clear();
+            if (self->timers == NULL) {
+                return PyList_New(0);
+            }
+        } else if (err < 0) {
+            return NULL;
+        }
+    }
+    if (max_events > CQE_BATCH_STACK) {
+        calls = PyMem_New(PendingCall, max_events);
+        if (calls == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+    rlist = IoUring_harvest(self, max_events, calls, &ncalls);
+    if (rlist == NULL) {
+        // cq is advanced past the failed cqe, callbacks collected
+        // before it are still called and the error is raised after.
+        PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+    }
+    for (unsigned i = 0; i < ncalls; i++) {
+        PyObject *callback = calls[i].callback;
+
+        Py_INCREF(callback);
+        ret = PendingCall_call(&calls[i]);
+        if (ret != NULL) {
+            Py_DECREF(ret);
+        } else if (exc_type == NULL) {
+            PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+        } else {
+            PyErr_WriteUnraisable(callback);
+        }
+        Py_DECREF(callback);
+    }
+    if (self->timers != NULL) {
+        // a callback may close and drop the wheel
+        PyObject *timers = (PyObject *) self->timers;
+
+        Py_INCREF(timers);
+        if (TimerWheel_expire_due(self->timers) < 0) {
+            if (exc_type == NULL) {
+                PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+            } else {
+                PyErr_WriteUnraisable(timers);
+            }
+        }
+        Py_DECREF(timers);
+    }
+    // sqes queued by callbacks and timers go to kernel together
+    err = IoUring_submit_and_wait(self, 0);
+    if (exc_type != NULL) {
+        Py_CLEAR(rlist);
+        PyErr_Restore(exc_type, exc_value, exc_tb);
+    } else if (err < 0) {
+        Py_CLEAR(rlist);
+        errno = -err;
+        PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (calls != stack_calls) {
+        PyMem_Free(calls);
+    }
+    return rlist;
+}
+
 PyDoc_STRVAR(
         sq_ready_doc,
         "sq_ready() -> int\n\n"
@@ -406,447 +1675,4255 @@ IoUring_cq_ready(IoUringObject *self)
     return PyLong_FromLong(nready);
 }
 
+PyDoc_STRVAR(
+        enable_stats_doc,
+        "enable_stats([enabled]) -> None\n\n"
+        "start collecting the counters and latency histograms reported by stats(),\n"
+        "they restart from zero when already enabled. enable_stats(False) stops\n"
+        "collecting and drops them.");
+
 static PyObject *
-IoUring_cq_event_fd_enabled(IoUringObject *self)
+IoUring_enable_stats(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    bool enabled = io_uring_cq_eventfd_enabled(self->ring);
-    return PyBool_FromLong(enabled);
+    int enabled = 1;
+
+    if (!Args_check("enable_stats", nargs, 0, 1)
+            || (nargs > 0 && (enabled = PyObject_IsTrue(args[0])) < 0)) {
+        return NULL;
+    }
+    IoUring_free_stats(self);
+    if (enabled) {
+        self->stats = PyMem_Calloc(1, sizeof(IoUringStats));
+        if (self->stats == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+    Py_RETURN_NONE;
 }
 
-// SqeObject methods definitions
+// set key of dict to an unsigned long long value
+static int
+Stats_set(PyObject *dict, PyObject *key, unsigned long long value)
+{
+    PyObject *obj = PyLong_FromUnsignedLongLong(value);
+    int ret;
+
+    if (obj == NULL || key == NULL) {
+        Py_XDECREF(obj);
+        Py_XDECREF(key);
+        return -1;
+    }
+    ret = PyDict_SetItem(dict, key, obj);
+    Py_DECREF(key);
+    Py_DECREF(obj);
+    return ret;
+}
 
+// {index: count} of the non-zero counters
 static PyObject *
-Sqe_new(PyTypeObject *type, PyObject *args, PyObject *kwls)
+Stats_counters(unsigned long long *counters, unsigned n)
 {
-    SqeObject *self;
-    self = (SqeObject *) (type->tp_alloc(type, 0));
-    if (self != NULL) {
-        self->fd = -1;
-        self->error = 0;
-        self->operation = -1;
-        self->allocated_buffer = NULL;
-        Py_buffer *buf = (Py_buffer *) PyMem_Malloc(sizeof(Py_buffer));
-        if (buf != NULL) {
-            self->user_buffer = buf;
-        } else {
-            Py_DECREF(self);
+    PyObject *dict = PyDict_New();
+
+    if (dict == NULL) {
+        return NULL;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        if (counters[i] && Stats_set(dict, PyLong_FromUnsignedLong(i), counters[i])) {
+            Py_DECREF(dict);
             return NULL;
         }
-        self->user_buffer->obj = NULL;
-        self->cqeobj = NULL;
-    } else {
-        return NULL;
     }
-    Py_INCREF(Py_None);
-    self->data = Py_None;
-    return (PyObject*) self;
+    return dict;
 }
 
-static void Sqe_reinit_buffer(SqeObject *self)
+static PyObject *
+Latency_summary(LatencyHistogram *hist)
 {
-    if (self->user_buffer->obj != NULL) {
-        PyBuffer_Release(self->user_buffer);
-        self->user_buffer->obj = NULL;
+    static const struct {
+        const char *name;
+        double quantile;
+    } percentiles[] = {
+        {"p50_ns", 0.5}, {"p90_ns", 0.9}, {"p99_ns", 0.99}, {"p999_ns", 0.999}
+    };
+    PyObject *dict, *buckets = NULL, *item;
+    unsigned long long seen, rank, value;
+    unsigned b = 0;
+
+    dict = PyDict_New();
+    if (dict == NULL) {
+        return NULL;
     }
-    if (self->allocated_buffer != NULL) {
-        Py_DECREF(self->allocated_buffer);
-        self->allocated_buffer = NULL;
+    if (Stats_set(dict, PyUnicode_FromString("count"), hist->count)
+            || Stats_set(dict, PyUnicode_FromString("min_ns"), hist->min_ns)
+            || Stats_set(dict, PyUnicode_FromString("max_ns"), hist->max_ns)
+            || Stats_set(dict, PyUnicode_FromString("mean_ns"), hist->sum_ns / hist->count)) {
+        goto error;
+    }
+    // a percentile is the upper bound of the bucket holding its rank
+    seen = 0;
+    for (unsigned i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        rank = (unsigned long long) (percentiles[i].quantile * hist->count);
+        if (rank == 0 || rank < percentiles[i].quantile * hist->count) {
+            rank++;
+        }
+        while (seen < rank) {
+            seen += hist->buckets[b++];
+        }
+        value = Latency_bucket_max(b - 1);
+        if (value > hist->max_ns) {
+            value = hist->max_ns;
+        }
+        if (Stats_set(dict, PyUnicode_FromString(percentiles[i].name), value)) {
+            goto error;
+        }
+    }
+    buckets = PyList_New(0);
+    if (buckets == NULL) {
+        goto error;
+    }
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        if (hist->buckets[b] == 0) {
+            continue;
+        }
+        item = Py_BuildValue("(KK)", Latency_bucket_max(b), hist->buckets[b]);
+        if (item == NULL || PyList_Append(buckets, item)) {
+            Py_XDECREF(item);
+            goto error;
+        }
+        Py_DECREF(item);
+    }
+    if (PyDict_SetItemString(dict, "buckets", buckets)) {
+        goto error;
     }
+    Py_DECREF(buckets);
+    return dict;
+error:
+    Py_XDECREF(buckets);
+    Py_DECREF(dict);
+    return NULL;
 }
 
-static void Sqe_dealloc(SqeObject *self)
+PyDoc_STRVAR(
+        stats_doc,
+        "stats() -> dict\n\n"
+        "snapshot of ring statistics. always present are \"enabled\", \"inflight\",\n"
+        "operations submitted and not completed yet, and \"cq_overflow\",\n"
+        "completions dropped by kernel. after enable_stats there are also\n"
+        "\"submitted\" and \"completed\", {opcode: count} of operations and cqes,\n"
+        "\"errors\", {errno: count} of failed cqes, \"enter_calls\", estimated\n"
+        "io_uring_enter(2) calls of submit and wait, \"sq_full\", times the\n"
+        "submission queue was full, and \"latency\", {opcode: histogram} of the\n"
+        "time from submit to the final cqe being seen. a histogram has count,\n"
+        "min_ns, max_ns, mean_ns, p50_ns, p90_ns, p99_ns, p999_ns and buckets,\n"
+        "a list of (upper_ns, count) with a precision of 12.5%.");
+
+static PyObject *
+IoUring_stats(IoUringObject *self)
 {
-    Sqe_reinit_buffer(self);
-    PyMem_Free(self->user_buffer);
-    Py_DECREF(self->data);
-    Py_TYPE(self)->tp_free((PyObject *) self);
-    return;
-}
+    IoUringStats *stats = self->stats;
+    PyObject *dict, *item;
+    unsigned inflight = 0, overflow = 0;
 
-PyDoc_STRVAR(
-        prep_send_doc,
-        "prep_send(fd, buf[, flags]) -> None\n\n"
-        "Issue the equivalent of a send(2) system call.");
+    if (self->slots != NULL) {
+        inflight = self->nslots - self->nfree - self->nwait_submit;
+        overflow = __atomic_load_n(self->ring->cq.koverflow, __ATOMIC_RELAXED);
+    }
+    dict = Py_BuildValue("{s:O,s:I,s:I}", "enabled", stats ? Py_True : Py_False,
+            "inflight", inflight, "cq_overflow", overflow);
+    if (dict == NULL || stats == NULL) {
+        return dict;
+    }
+    if (Stats_set(dict, PyUnicode_FromString("enter_calls"), stats->enter_calls)
+            || Stats_set(dict, PyUnicode_FromString("sq_full"), stats->sq_full)) {
+        goto error;
+    }
+#define SET_COUNTERS(key, counters) do { \
+    item = Stats_counters((counters), sizeof(counters) / sizeof((counters)[0])); \
+    if (item == NULL || PyDict_SetItemString(dict, (key), item)) { \
+        Py_XDECREF(item); \
+        goto error; \
+    } \
+    Py_DECREF(item); \
+} while (0)
+    SET_COUNTERS("submitted", stats->submitted);
+    SET_COUNTERS("completed", stats->completed);
+    SET_COUNTERS("errors", stats->errors);
+#undef SET_COUNTERS
+    item = PyDict_New();
+    if (item == NULL || PyDict_SetItemString(dict, "latency", item)) {
+        Py_XDECREF(item);
+        goto error;
+    }
+    Py_DECREF(item);
+    for (unsigned op = 0; op < IORING_OP_LAST; op++) {
+        PyObject *key, *summary;
+        int ret;
+
+        if (stats->latency[op] == NULL || stats->latency[op]->count == 0) {
+            continue;
+        }
+        summary = Latency_summary(stats->latency[op]);
+        key = PyLong_FromUnsignedLong(op);
+        ret = summary == NULL || key == NULL || PyDict_SetItem(item, key, summary);
+        Py_XDECREF(summary);
+        Py_XDECREF(key);
+        if (ret) {
+            goto error;
+        }
+    }
+    return dict;
+error:
+    Py_DECREF(dict);
+    return NULL;
+}
 
 static PyObject *
-Sqe_prep_send(SqeObject *self, PyObject *args)
+IoUring_cq_event_fd_enabled(IoUringObject *self)
 {
-    char *buf;
-    int fd, len, flags = 0;
+    bool enabled = io_uring_cq_eventfd_enabled(self->ring);
+    return PyBool_FromLong(enabled);
+}
 
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "iy*|i:prep_send", &fd, self->user_buffer, &flags)) {
+// convert a sequence of fds into a PyMem array, -1 marks an empty slot
+static int *
+IoUring_fd_array(PyObject *fds, unsigned *nr)
+{
+    PyObject *seq;
+    Py_ssize_t n;
+    int *files;
+
+    seq = PySequence_Fast(fds, "fds must be a sequence of int");
+    if (seq == NULL) {
         return NULL;
     }
-    buf = self->user_buffer->buf;
-    len = self->user_buffer->len;
-    io_uring_prep_send(self->sqe, fd, buf, len, flags);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    n = PySequence_Fast_GET_SIZE(seq);
+    if (n == 0 || n > UINT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "invalid number of fds");
+        Py_DECREF(seq);
+        return NULL;
+    }
+    files = PyMem_New(int, n);
+    if (files == NULL) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        files[i] = _PyLong_AsInt(PySequence_Fast_GET_ITEM(seq, i));
+        if (files[i] == -1 && PyErr_Occurred()) {
+            PyMem_Free(files);
+            Py_DECREF(seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(seq);
+    *nr = (unsigned) n;
+    return files;
 }
 
 PyDoc_STRVAR(
-        prep_recv_doc,
-        "prep_recv(fd, len[, flags]) -> None\n\n"
-        "Issue the equivalent of recv(2) system call.");
+        register_files_doc,
+        "register_files(fds) -> None\n\n"
+        "register a table of fds, sqe marked by set_fixed_file refer to fd by index in it.\n"
+        "-1 leaves a slot empty, an int fds registers an empty table of that size.");
 
 static PyObject *
-Sqe_prep_recv(SqeObject *self, PyObject *args)
+IoUring_register_files(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    int fd, len, flags = 0;
+    PyObject *fds;
+    int *files = NULL;
+    unsigned nr;
+    int ret;
 
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "ii|i:prep_recv", &fd, &len, &flags)) {
+    if (!Args_check("register_files", nargs, 1, 1)) {
         return NULL;
     }
-    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, len);
-    char *buf = PyBytes_AS_STRING(self->allocated_buffer);
-    io_uring_prep_recv(self->sqe, fd, buf, len, flags);
-    self->operation = self->sqe->opcode;
+    fds = args[0];
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (PyLong_Check(fds)) {
+        nr = PyLong_AsUnsignedLong(fds);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    } else if ((files = IoUring_fd_array(fds, &nr)) == NULL) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (files == NULL) {
+        ret = io_uring_register_files_sparse(self->ring, nr);
+    } else {
+        ret = io_uring_register_files(self->ring, files, nr);
+    }
+    Py_END_ALLOW_THREADS
+    PyMem_Free(files);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
     Py_RETURN_NONE;
 }
 
 PyDoc_STRVAR(
-        prep_connect_doc,
-        "prep_connect(fd, addr) -> None\n\n"
-        "Issue the equivalent of a connect(2) system call.");
+        register_files_update_doc,
+        "register_files_update(offset, fds) -> int\n\n"
+        "replace registered fds starting at index offset, -1 clears a slot.\n"
+        "return the number of slots updated.");
 
 static PyObject *
-Sqe_prep_connect(SqeObject *self, PyObject *args)
+IoUring_register_files_update(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    // TODO: support ipv6 connect
-    PyObject *addrobj;
-    struct sockaddr_in *addr;
-    socklen_t addrlen = sizeof(struct sockaddr_in);
-    char *ip;
-    unsigned port;
-    int fd;
+    PyObject *fds;
+    int *files;
+    unsigned offset, nr;
+    int ret;
 
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "iO!:prep_connect", &fd, &PyTuple_Type, &addrobj)) {
+    if (!Args_check("register_files_update", nargs, 2, 2)
+            || !Arg_uint(args[0], &offset)) {
         return NULL;
     }
-    if (!PyArg_ParseTuple(addrobj, "sI:prep_connect", &ip, &port)) {
+    fds = args[1];
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
         return NULL;
     }
-
-    self->allocated_buffer = PyBytes_FromStringAndSize((char *) 0, sizeof(struct sockaddr_in));
-    addr = (struct sockaddr_in*) PyBytes_AS_STRING(self->allocated_buffer);
-    addr->sin_family = AF_INET;
-    inet_pton(AF_INET, ip, &(addr->sin_addr));
-    addr->sin_port = htons(port);
-    io_uring_prep_connect(self->sqe, fd, (struct sockaddr *) addr, addrlen);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    files = IoUring_fd_array(fds, &nr);
+    if (files == NULL) {
+        return NULL;
+    }
+    ret = io_uring_register_files_update(self->ring, offset, files, nr);
+    PyMem_Free(files);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    return PyLong_FromLong(ret);
 }
 
 PyDoc_STRVAR(
-        prep_accept_doc,
-        "prep_accept(fd[, flags]) -> None\n\n"
-        "Issue the equivalent of an accept4(2) system call.");
+        unregister_files_doc,
+        "unregister_files() -> None\n\n"
+        "unregister the table of fds.");
 
 static PyObject *
-Sqe_prep_accept(SqeObject *self, PyObject *args)
+IoUring_unregister_files(IoUringObject *self)
 {
-    // TODO: support ipv6 accept
-    struct sockaddr_in *addr;
-    socklen_t *addrlen;
-    int fd, flags = 0;
+    int ret;
 
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "i|i:prep_accept", &fd, &flags)) {
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
         return NULL;
     }
-    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, sizeof(struct sockaddr_in) + sizeof(socklen_t));
-    addr = (struct sockaddr_in*) PyBytes_AS_STRING(self->allocated_buffer);
-    addrlen = (socklen_t *)(addr + 1);
-    *addrlen = sizeof(struct sockaddr_in);
-    io_uring_prep_accept(self->sqe, fd, (struct sockaddr *) addr, addrlen, flags);
-    self->operation = self->sqe->opcode;
+    Py_BEGIN_ALLOW_THREADS
+    ret = io_uring_unregister_files(self->ring);
+    Py_END_ALLOW_THREADS
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
     Py_RETURN_NONE;
 }
 
 static PyObject *
-Sqe_convert_address(SqeObject *self)
+IoUring_register_eventfd_impl(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs, int async)
 {
-    struct sockaddr_in *addr;
-    socklen_t *addrlen;
-    unsigned short port;
-    addr = (struct sockaddr_in*) PyBytes_AS_STRING(self->allocated_buffer);
-    addrlen = (socklen_t *)(addr + 1);
-    char *ip = PyMem_Malloc(*addrlen);
-    if (inet_ntop(AF_INET, &addr->sin_addr, ip, 1024) == NULL) {
-        PyMem_Free(ip);
+    int fd, ret;
+
+    if (!Args_check(async ? "register_eventfd_async" : "register_eventfd", nargs, 1, 1)
+            || !Arg_int(args[0], &fd)) {
+        return NULL;
+    }
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (async) {
+        ret = io_uring_register_eventfd_async(self->ring, fd);
+    } else {
+        ret = io_uring_register_eventfd(self->ring, fd);
+    }
+    if (ret < 0) {
+        errno = -ret;
         return PyErr_SetFromErrno(PyExc_OSError);
     }
-    port = ntohs(addr->sin_port);
-    PyObject *ret = Py_BuildValue("sh", ip, port);
-    PyMem_Free(ip);
-    return ret;
+    Py_RETURN_NONE;
 }
 
 PyDoc_STRVAR(
-        prep_read_doc,
-        "prep_read(fd, len[, flags]) -> None\n\n"
-        "Issue the equivalent of a read(2) system call.");
+        register_eventfd_doc,
+        "register_eventfd(fd) -> None\n\n"
+        "register eventfd fd, kernel signals it whenever a cqe is posted.");
 
 static PyObject *
-Sqe_prep_read(SqeObject *self, PyObject *args)
+IoUring_register_eventfd(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    int fd, len, offset;
-    Sqe_reinit_buffer(self);
+    return IoUring_register_eventfd_impl(self, args, nargs, 0);
+}
+
+PyDoc_STRVAR(
+        register_eventfd_async_doc,
+        "register_eventfd_async(fd) -> None\n\n"
+        "like register_eventfd, but only signal fd for completions which did not\n"
+        "complete inline during submit.");
+
+static PyObject *
+IoUring_register_eventfd_async(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    return IoUring_register_eventfd_impl(self, args, nargs, 1);
+}
+
+PyDoc_STRVAR(
+        unregister_eventfd_doc,
+        "unregister_eventfd() -> None\n\n"
+        "unregister the eventfd.");
+
+static PyObject *
+IoUring_unregister_eventfd(IoUringObject *self)
+{
+    int ret;
 
-    if (!PyArg_ParseTuple(args, "ii|i:prep_read", &fd, &len, &offset)) {
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
         return NULL;
     }
-    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, len);
-    char *buf = PyBytes_AS_STRING(self->allocated_buffer);
-    io_uring_prep_read(self->sqe, fd, buf, len, offset);
-    self->operation = self->sqe->opcode;
+    ret = io_uring_unregister_eventfd(self->ring);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
     Py_RETURN_NONE;
 }
 
 PyDoc_STRVAR(
-        prep_write_doc,
-        "prep_write(fd, buf[, flags]) -> None\n\n"
-        "Issue the equivalent of a write(2) system call.");
+        fileno_doc,
+        "fileno() -> int\n\n"
+        "return the ring fd, it is readable when completions are ready.");
 
 static PyObject *
-Sqe_prep_write(SqeObject *self, PyObject *args)
+IoUring_fileno(IoUringObject *self)
 {
-    char *buf;
-    int fd, len, offset;
-
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "iy*|i:prep_write", &fd, self->user_buffer, &offset)) {
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
         return NULL;
     }
-    buf = self->user_buffer->buf;
-    len = self->user_buffer->len;
-    io_uring_prep_write(self->sqe, fd, buf, len, offset);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    return PyLong_FromLong(self->ring->ring_fd);
 }
 
 PyDoc_STRVAR(
-        prep_nop_doc,
-        "prep_nop() -> None\n\n"
-        );
+        stream_file_doc,
+        "stream_file(fd[, chunk_size[, depth[, offset[, length]]]]) -> FileStream\n\n"
+        "iterate over a file in chunks of chunk_size, 64KiB by default, keeping depth\n"
+        "reads in flight, 4 by default. length -1 means reading to end of file.");
 
 static PyObject *
-Sqe_prep_nop(SqeObject *self)
+IoUring_stream_file(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    io_uring_prep_nop(self->sqe);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    return FileStream_new(self, args, nargs);
 }
 
 PyDoc_STRVAR(
-        prep_timeout_doc,
-        "prep_timeout(timeout[, flags]) -> None\n\n"
-        "prepare a timeout operation");
+        submit_ops_doc,
+        "submit_ops(ops[, wait_nr]) -> int\n\n"
+        "prepare an sqe for each (opcode, fd, buf, offset, flags, data) tuple of ops\n"
+        "and submit them, then wait for wait_nr completions. return number of sqes\n"
+        "submitted. opcode is one of IORING_OP_NOP, READ, WRITE, READV, WRITEV,\n"
+        "RECV, SEND, FSYNC and CLOSE. buf is the length to read or receive into a\n"
+        "new bytes, or the buffer (list of buffers for READV/WRITEV) to use. offset\n"
+        "is -1 for current file position and ignored by ops without one. flags are\n"
+        "IOSQE_* and data is what cqe.get_data() returns. submission queue is\n"
+        "flushed whenever it fills up. when a tuple is invalid the ops before it are\n"
+        "still submitted, a nop takes its place and the error is raised.");
 
 static PyObject *
-Sqe_prep_timeout(SqeObject *self, PyObject *args)
+IoUring_submit_ops(IoUringObject *self, PyObject *const *args, Py_ssize_t nargs)
 {
-    double timeout;
-    unsigned int count= 0, flags = 0;
+    PyObject *ops, **items;
+    SqeObject *sqeobj;
+    Py_ssize_t nops;
+    unsigned wait_nr = 0;
+    int ret, submitted = 0, failed = 0;
 
-    Sqe_reinit_buffer(self);
-    if (!PyArg_ParseTuple(args, "d|II:prep_timeout", &timeout, &count, &flags)) {
+    if (!Args_check("submit_ops", nargs, 1, 2)
+            || (nargs > 1 && !Arg_uint(args[1], &wait_nr))) {
         return NULL;
     }
-    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, sizeof(struct __kernel_timespec));
-    struct __kernel_timespec *ts = (struct __kernel_timespec *) PyBytes_AS_STRING(self->allocated_buffer);
-    ts->tv_sec = (long long) timeout;
-    ts->tv_nsec = (long long) ((timeout - ts->tv_sec) * 1e9);
-    io_uring_prep_timeout(self->sqe, ts, count, flags);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    if (self->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    ops = PySequence_Fast(args[0], "submit_ops() argument 1 must be a sequence");
+    if (ops == NULL) {
+        return NULL;
+    }
+    nops = PySequence_Fast_GET_SIZE(ops);
+    items = PySequence_Fast_ITEMS(ops);
+    for (Py_ssize_t i = 0; i < nops; i++) {
+        if (io_uring_sq_space_left(self->ring) == 0) {
+            if (self->stats != NULL) {
+                self->stats->sq_full++;
+            }
+            ret = IoUring_submit_and_wait(self, 0);
+            if (ret < 0) {
+                goto error;
+            }
+            submitted += ret;
+        }
+        sqeobj = (SqeObject *) IoUring_get_sqe(self);
+        if (sqeobj == NULL) {
+            failed = 1;
+            break;
+        }
+        if (Sqe_prep_record(sqeobj, items[i]) < 0) {
+            // the slot is taken already, make it harmless
+            Sqe_reinit_buffer(sqeobj);
+            io_uring_prep_nop(sqeobj->sqe);
+            sqeobj->operation = IORING_OP_NOP;
+            Py_DECREF(sqeobj);
+            failed = 1;
+            break;
+        }
+        Py_DECREF(sqeobj);
+    }
+    Py_DECREF(ops);
+    if (failed) {
+        // earlier ops are submitted, the error of the failed one wins
+        PyObject *type, *value, *tb;
+        PyErr_Fetch(&type, &value, &tb);
+        IoUring_submit_and_wait(self, 0);
+        PyErr_Restore(type, value, tb);
+        return NULL;
+    }
+    ret = IoUring_submit_and_wait(self, wait_nr);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    return PyLong_FromLong(submitted + ret);
+error:
+    Py_DECREF(ops);
+    errno = -ret;
+    return PyErr_SetFromErrno(PyExc_OSError);
+}
+
+// SqeObject methods definitions
+
+static PyObject *
+Sqe_new(PyTypeObject *type, PyObject *args, PyObject *kwls)
+{
+    SqeObject *self;
+    self = (SqeObject *) (type->tp_alloc(type, 0));
+    if (self != NULL) {
+        self->sqe = NULL;
+        self->user_data = 0;
+        self->fd = -1;
+        self->error = 0;
+        self->operation = -1;
+        self->allocated_buffer = NULL;
+        self->user_buffer.obj = NULL;
+        self->iovecs = NULL;
+        self->iov_views = NULL;
+        self->niov = 0;
+        self->addrlen = 0;
+        self->accept_mode = 0;
+        self->callback = NULL;
+        self->cbargs = NULL;
+        self->submit_ns = 0;
+        self->cqeobj = NULL;
+    } else {
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    self->data = Py_None;
+    return (PyObject*) self;
+}
+
+static void Sqe_reinit_buffer(SqeObject *self)
+{
+    // prepared again before submitted, the message is never sent
+    if (self->sqe != NULL && self->operation == IORING_OP_MSG_RING
+            && self->allocated_buffer != NULL) {
+        IoUring_release_msg_slot(self);
+    }
+    if (self->user_buffer.obj != NULL) {
+        PyBuffer_Release(&self->user_buffer);
+        self->user_buffer.obj = NULL;
+    }
+    if (self->allocated_buffer != NULL) {
+        Py_DECREF(self->allocated_buffer);
+        self->allocated_buffer = NULL;
+    }
+    if (self->iovecs != NULL) {
+        for (unsigned i = 0; i < self->niov; i++) {
+            PyBuffer_Release(&self->iov_views[i]);
+        }
+        PyMem_Free(self->iovecs);
+        self->iovecs = NULL;
+        self->iov_views = NULL;
+        self->niov = 0;
+    }
+    self->addrlen = 0;
+    self->accept_mode = 0;
+}
+
+// bring a recycled slot object back to the state of Sqe_new
+static void Sqe_reset(SqeObject *self)
+{
+    self->sqe = NULL;
+    self->fd = -1;
+    self->error = 0;
+    self->operation = -1;
+    self->submit_ns = 0;
+    self->cqeobj = NULL;
+    Sqe_reinit_buffer(self);
+    Py_INCREF(Py_None);
+    Py_SETREF(self->data, Py_None);
+    Py_CLEAR(self->callback);
+    Py_CLEAR(self->cbargs);
+}
+
+static void Sqe_dealloc(SqeObject *self)
+{
+    Sqe_reinit_buffer(self);
+    Py_DECREF(self->data);
+    Py_XDECREF(self->callback);
+    Py_XDECREF(self->cbargs);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+    return;
+}
+
+// sqe is only writable between get_sqe and submit
+static inline int
+Sqe_acquired(SqeObject *self)
+{
+    if (self->sqe == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Sqe is not acquired from ring or has been submitted");
+        return 0;
+    }
+    return 1;
+}
+
+// length field of sqe is 32 bits, a larger user buffer would be cut short
+static int
+Sqe_check_buffer_len(SqeObject *self)
+{
+    if (self->user_buffer.len > UINT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "buffer is too large for one sqe");
+        Sqe_reinit_buffer(self);
+        return 0;
+    }
+    return 1;
+}
+
+PyDoc_STRVAR(
+        prep_send_doc,
+        "prep_send(fd, buf[, flags]) -> None\n\n"
+        "Issue the equivalent of a send(2) system call.");
+
+static PyObject *
+Sqe_prep_send(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    char *buf;
+    int fd, len, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_send", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_int(args[2], &flags))
+            || !Arg_buffer(args[1], &self->user_buffer, 0, "prep_send", 1)) {
+        return NULL;
+    }
+    buf = self->user_buffer.buf;
+    len = self->user_buffer.len;
+    io_uring_prep_send(self->sqe, fd, buf, len, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_recv_doc,
+        "prep_recv(fd, len[, flags]) -> None\n\n"
+        "Issue the equivalent of recv(2) system call.");
+
+static PyObject *
+Sqe_prep_recv(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, len, flags = 0;
+    char *buf;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_recv", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || !Arg_int(args[1], &len)
+            || (nargs > 2 && !Arg_int(args[2], &flags))) {
+        return NULL;
+    }
+    if (len < 0) {
+        PyErr_SetString(PyExc_ValueError, "negative len");
+        return NULL;
+    }
+    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, len);
+    if (self->allocated_buffer == NULL) {
+        return NULL;
+    }
+    buf = PyBytes_AS_STRING(self->allocated_buffer);
+    io_uring_prep_recv(self->sqe, fd, buf, len, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_recv_into_doc,
+        "prep_recv_into(fd, buffer[, flags]) -> None\n\n"
+        "Issue the equivalent of recv(2) system call into a writable buffer,\n"
+        "result is the number of bytes received.");
+
+static PyObject *
+Sqe_prep_recv_into(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_recv_into", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_int(args[2], &flags))
+            || !Arg_buffer(args[1], &self->user_buffer, PyBUF_WRITABLE, "prep_recv_into", 1)) {
+        return NULL;
+    }
+    if (!Sqe_check_buffer_len(self)) {
+        return NULL;
+    }
+    io_uring_prep_recv(self->sqe, fd, self->user_buffer.buf, self->user_buffer.len, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_recv_select_doc,
+        "prep_recv_select(fd, bufring[, flags]) -> None\n\n"
+        "Issue the equivalent of recv(2) system call into a buffer selected\n"
+        "from BufferRing by kernel when data arrives.");
+
+static PyObject *
+Sqe_prep_recv_select(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    BufferRingObject *bufring;
+    int fd, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_recv_select", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || !Arg_type(args[1], &BufferRingType, "prep_recv_select", 1)
+            || (nargs > 2 && !Arg_int(args[2], &flags))) {
+        return NULL;
+    }
+    bufring = (BufferRingObject *) args[1];
+    if (bufring->br == NULL) {
+        PyErr_SetString(PyExc_ValueError, "BufferRing is closed");
+        return NULL;
+    }
+    // keep buffer ring alive until the completion is converted
+    Py_INCREF(bufring);
+    self->allocated_buffer = (PyObject *) bufring;
+    io_uring_prep_recv(self->sqe, fd, NULL, bufring->size, flags);
+    io_uring_sqe_set_flags(self->sqe, IOSQE_BUFFER_SELECT);
+    self->sqe->buf_group = bufring->bgid;
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_recv_multishot_doc,
+        "prep_recv_multishot(fd, bufring[, flags]) -> None\n\n"
+        "like prep_recv_select, but keep receiving into buffers of bufring, posting a\n"
+        "cqe for every chunk. the operation is still armed while IORING_CQE_F_MORE\n"
+        "is set in cqe flags, it terminates on error, end of stream or ENOBUFS.");
+
+static PyObject *
+Sqe_prep_recv_multishot(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    BufferRingObject *bufring;
+    int fd, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_recv_multishot", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || !Arg_type(args[1], &BufferRingType, "prep_recv_multishot", 1)
+            || (nargs > 2 && !Arg_int(args[2], &flags))) {
+        return NULL;
+    }
+    bufring = (BufferRingObject *) args[1];
+    if (bufring->br == NULL) {
+        PyErr_SetString(PyExc_ValueError, "BufferRing is closed");
+        return NULL;
+    }
+    Py_INCREF(bufring);
+    self->allocated_buffer = (PyObject *) bufring;
+    io_uring_prep_recv_multishot(self->sqe, fd, NULL, 0, flags);
+    io_uring_sqe_set_flags(self->sqe, IOSQE_BUFFER_SELECT);
+    self->sqe->buf_group = bufring->bgid;
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+// fill self->addr from a python address the way the socket module spells
+// it: str, bytes or path-like for AF_UNIX (a leading nul byte selects the
+// linux abstract namespace), (host, port) for AF_INET and
+// (host, port[, flowinfo[, scope_id]]) for AF_INET6. host must be numeric,
+// name resolution is left to the caller.
+static int
+Sqe_store_address(SqeObject *self, PyObject *addrobj)
+{
+    memset(&self->addr, 0, sizeof(self->addr));
+    if (PyTuple_Check(addrobj)) {
+        const char *host;
+        unsigned port, flowinfo = 0, scope_id = 0;
+
+        if (!PyArg_ParseTuple(addrobj, "sI|II:prep_connect", &host, &port, &flowinfo, &scope_id)) {
+            return -1;
+        }
+        if (port > 0xffff) {
+            PyErr_SetString(PyExc_OverflowError, "port must be 0-65535");
+            return -1;
+        }
+        struct sockaddr_in *sin = (struct sockaddr_in *) &self->addr;
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &self->addr;
+        if (PyTuple_GET_SIZE(addrobj) == 2 && inet_pton(AF_INET, host, &sin->sin_addr) == 1) {
+            sin->sin_family = AF_INET;
+            sin->sin_port = htons(port);
+            self->addrlen = sizeof(*sin);
+        } else if (inet_pton(AF_INET6, host, &sin6->sin6_addr) == 1) {
+            sin6->sin6_family = AF_INET6;
+            sin6->sin6_port = htons(port);
+            sin6->sin6_flowinfo = htonl(flowinfo);
+            sin6->sin6_scope_id = scope_id;
+            self->addrlen = sizeof(*sin6);
+        } else {
+            PyErr_Format(PyExc_ValueError, "%s is not a numeric IPv4 or IPv6 address", host);
+            return -1;
+        }
+        return 0;
+    }
+
+    // unlike PyUnicode_FSConverter, keep embedded nul of abstract names
+    PyObject *path = PyOS_FSPath(addrobj);
+    if (path != NULL && PyUnicode_Check(path)) {
+        Py_SETREF(path, PyUnicode_EncodeFSDefault(path));
+    }
+    if (path == NULL) {
+        return -1;
+    }
+    struct sockaddr_un *sun = (struct sockaddr_un *) &self->addr;
+    Py_ssize_t len = PyBytes_GET_SIZE(path);
+    const char *name = PyBytes_AS_STRING(path);
+    // abstract names are not nul terminated, paths need room for one
+    int abstract = len > 0 && name[0] == '\0';
+    if ((size_t) len + !abstract > sizeof(sun->sun_path)) {
+        Py_DECREF(path);
+        PyErr_SetString(PyExc_OSError, "AF_UNIX path too long");
+        return -1;
+    }
+    sun->sun_family = AF_UNIX;
+    memcpy(sun->sun_path, name, len);
+    self->addrlen = offsetof(struct sockaddr_un, sun_path) + len + !abstract;
+    Py_DECREF(path);
+    return 0;
+}
+
+// python object for self->addr, in the form accepted by Sqe_store_address
+static PyObject *
+Sqe_address_object(SqeObject *self)
+{
+    switch (self->addr.ss_family) {
+        case AF_INET: {
+            struct sockaddr_in *sin = (struct sockaddr_in *) &self->addr;
+            char host[INET_ADDRSTRLEN];
+            if (inet_ntop(AF_INET, &sin->sin_addr, host, sizeof(host)) == NULL) {
+                return PyErr_SetFromErrno(PyExc_OSError);
+            }
+            return Py_BuildValue("sH", host, ntohs(sin->sin_port));
+        }
+        case AF_INET6: {
+            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &self->addr;
+            char host[INET6_ADDRSTRLEN];
+            if (inet_ntop(AF_INET6, &sin6->sin6_addr, host, sizeof(host)) == NULL) {
+                return PyErr_SetFromErrno(PyExc_OSError);
+            }
+            return Py_BuildValue("sHII", host, ntohs(sin6->sin6_port),
+                    ntohl(sin6->sin6_flowinfo), sin6->sin6_scope_id);
+        }
+        case AF_UNIX: {
+            struct sockaddr_un *sun = (struct sockaddr_un *) &self->addr;
+            size_t len = 0;
+            if (self->addrlen > offsetof(struct sockaddr_un, sun_path)) {
+                len = self->addrlen - offsetof(struct sockaddr_un, sun_path);
+            }
+            if (len > 0 && sun->sun_path[0] == '\0') {
+                return PyBytes_FromStringAndSize(sun->sun_path, len);
+            }
+            // unnamed peers have an empty path
+            return PyUnicode_DecodeFSDefaultAndSize(sun->sun_path, strnlen(sun->sun_path, len));
+        }
+        default:
+            PyErr_Format(PyExc_ValueError, "unsupported address family %d", self->addr.ss_family);
+            return NULL;
+    }
+}
+
+PyDoc_STRVAR(
+        prep_connect_doc,
+        "prep_connect(fd, addr) -> None\n\n"
+        "Issue the equivalent of a connect(2) system call. addr is (host, port)\n"
+        "for AF_INET, (host, port[, flowinfo[, scope_id]]) for AF_INET6 and a\n"
+        "path for AF_UNIX, a leading nul byte selects the abstract namespace.\n"
+        "host must be a numeric address.");
+
+static PyObject *
+Sqe_prep_connect(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *addrobj;
+    int fd;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_connect", nargs, 2, 2)
+            || !Arg_int(args[0], &fd)) {
+        return NULL;
+    }
+    addrobj = args[1];
+    if (Sqe_store_address(self, addrobj) < 0) {
+        return NULL;
+    }
+    io_uring_prep_connect(self->sqe, fd, (struct sockaddr *) &self->addr, self->addrlen);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+// prep_accept modes
+#define ACCEPT_ADDR 1 // keep the peer address for convert_address
+#define ACCEPT_RESULT_ADDR 2 // getresult returns (fd, addr)
+#define ACCEPT_NO_ADDR 3 // peer address is not asked from kernel
+
+PyDoc_STRVAR(
+        prep_accept_doc,
+        "prep_accept(fd[, flags[, mode]]) -> None\n\n"
+        "Issue the equivalent of an accept4(2) system call. with mode ACCEPT_ADDR,\n"
+        "the default, result is the new fd and peer address is available from\n"
+        "convert_address. ACCEPT_RESULT_ADDR makes result (fd, addr), and\n"
+        "ACCEPT_NO_ADDR does not ask the peer address at all.");
+
+static PyObject *
+Sqe_prep_accept(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, flags = 0, mode = ACCEPT_ADDR;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_accept", nargs, 1, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 1 && !Arg_int(args[1], &flags))
+            || (nargs > 2 && !Arg_int(args[2], &mode))) {
+        return NULL;
+    }
+    if (mode == ACCEPT_NO_ADDR) {
+        io_uring_prep_accept(self->sqe, fd, NULL, NULL, flags);
+    } else if (mode == ACCEPT_ADDR || mode == ACCEPT_RESULT_ADDR) {
+        self->addr.ss_family = AF_UNSPEC;
+        self->addrlen = sizeof(self->addr);
+        io_uring_prep_accept(self->sqe, fd, (struct sockaddr *) &self->addr, &self->addrlen, flags);
+    } else {
+        PyErr_Format(PyExc_ValueError, "invalid accept mode %d", mode);
+        return NULL;
+    }
+    self->accept_mode = mode;
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_accept_direct_doc,
+        "prep_accept_direct(fd[, file_index[, flags]]) -> None\n\n"
+        "accept a connection into registered files slot file_index instead of\n"
+        "the process fd table, result is 0. when file_index is omitted or -1\n"
+        "kernel picks a free slot and result is its index.");
+
+static PyObject *
+Sqe_prep_accept_direct(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, file_index = -1, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_accept_direct", nargs, 1, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 1 && !Arg_int(args[1], &file_index))
+            || (nargs > 2 && !Arg_int(args[2], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_accept_direct(self->sqe, fd, NULL, NULL, flags,
+            file_index < 0 ? IORING_FILE_INDEX_ALLOC : (unsigned) file_index);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_multishot_accept_doc,
+        "prep_multishot_accept(fd[, flags]) -> None\n\n"
+        "accept connections until cancelled, posting a cqe with the new fd for each.\n"
+        "the operation is still armed while IORING_CQE_F_MORE is set in cqe flags.");
+
+static PyObject *
+Sqe_prep_multishot_accept(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_multishot_accept", nargs, 1, 2)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 1 && !Arg_int(args[1], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_multishot_accept(self->sqe, fd, NULL, NULL, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        convert_address_doc,
+        "convert_address() -> addr\n\n"
+        "peer address of a completed accept or the address of a connect, in the\n"
+        "form taken by prep_connect.");
+
+static PyObject *
+Sqe_convert_address(SqeObject *self)
+{
+    if (self->addrlen == 0 || self->addr.ss_family == AF_UNSPEC) {
+        PyErr_SetString(PyExc_ValueError, "no address stored in this sqe");
+        return NULL;
+    }
+    return Sqe_address_object(self);
+}
+
+PyDoc_STRVAR(
+        prep_read_doc,
+        "prep_read(fd, len[, offset]) -> None\n\n"
+        "Issue the equivalent of a pread(2) system call, or read(2) at current\n"
+        "file position when offset is omitted or -1.");
+
+static PyObject *
+Sqe_prep_read(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, len;
+    long long offset = -1;
+    char *buf;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+
+    if (!Args_check("prep_read", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || !Arg_int(args[1], &len)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))) {
+        return NULL;
+    }
+    if (len < 0) {
+        PyErr_SetString(PyExc_ValueError, "negative len");
+        return NULL;
+    }
+    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, len);
+    if (self->allocated_buffer == NULL) {
+        return NULL;
+    }
+    buf = PyBytes_AS_STRING(self->allocated_buffer);
+    io_uring_prep_read(self->sqe, fd, buf, len, (__u64) offset);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_read_into_doc,
+        "prep_read_into(fd, buffer[, offset]) -> None\n\n"
+        "Issue the equivalent of a pread(2) system call into a writable buffer,\n"
+        "result is the number of bytes read. offset -1 reads at file position.");
+
+static PyObject *
+Sqe_prep_read_into(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd;
+    long long offset = -1;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_read_into", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || !Arg_buffer(args[1], &self->user_buffer, PyBUF_WRITABLE, "prep_read_into", 1)) {
+        return NULL;
+    }
+    if (!Sqe_check_buffer_len(self)) {
+        return NULL;
+    }
+    if (AlignedBuffer_check_io(&self->user_buffer, offset) < 0) {
+        Sqe_reinit_buffer(self);
+        return NULL;
+    }
+    io_uring_prep_read(self->sqe, fd, self->user_buffer.buf,
+            (unsigned) self->user_buffer.len, (__u64) offset);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_write_doc,
+        "prep_write(fd, buf[, offset]) -> None\n\n"
+        "Issue the equivalent of a pwrite(2) system call, or write(2) at current\n"
+        "file position when offset is omitted or -1.");
+
+static PyObject *
+Sqe_prep_write(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd;
+    long long offset = -1;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_write", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || !Arg_buffer(args[1], &self->user_buffer, 0, "prep_write", 1)) {
+        return NULL;
+    }
+    if (!Sqe_check_buffer_len(self)) {
+        return NULL;
+    }
+    if (AlignedBuffer_check_io(&self->user_buffer, offset) < 0) {
+        Sqe_reinit_buffer(self);
+        return NULL;
+    }
+    io_uring_prep_write(self->sqe, fd, self->user_buffer.buf,
+            (unsigned) self->user_buffer.len, (__u64) offset);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+// pin every buffer of sequence bufs and build iovecs pointing to them
+static int
+Sqe_build_iovecs(SqeObject *self, PyObject *bufs, int writable, long long offset)
+{
+    PyObject *seq;
+    Py_ssize_t n;
+
+    seq = PySequence_Fast(bufs, "buffers must be a sequence");
+    if (seq == NULL) {
+        return -1;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+    if (n == 0 || n > UIO_MAXIOV) {
+        PyErr_Format(PyExc_ValueError, "number of buffers must be in 1..%d", UIO_MAXIOV);
+        Py_DECREF(seq);
+        return -1;
+    }
+    self->iovecs = PyMem_Malloc(n * (sizeof(struct iovec) + sizeof(Py_buffer)));
+    if (self->iovecs == NULL) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->iov_views = (Py_buffer *) (self->iovecs + n);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &self->iov_views[i],
+                    writable ? PyBUF_WRITABLE : PyBUF_SIMPLE) < 0) {
+            Py_DECREF(seq);
+            // release views pinned so far
+            Sqe_reinit_buffer(self);
+            return -1;
+        }
+        self->niov++;
+        if (AlignedBuffer_check_io(&self->iov_views[i], offset) < 0) {
+            Py_DECREF(seq);
+            Sqe_reinit_buffer(self);
+            return -1;
+        }
+        self->iovecs[i].iov_base = self->iov_views[i].buf;
+        self->iovecs[i].iov_len = self->iov_views[i].len;
+    }
+    Py_DECREF(seq);
+    return 0;
+}
+
+PyDoc_STRVAR(
+        prep_readv_doc,
+        "prep_readv(fd, buffers[, offset[, flags]]) -> None\n\n"
+        "Issue the equivalent of a preadv2(2) system call, scattering data into\n"
+        "a sequence of writable buffers. flags are os.RWF_*, offset -1 reads at\n"
+        "file position. result is the total number of bytes read.");
+
+static PyObject *
+Sqe_prep_readv(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *bufs;
+    int fd, flags = 0;
+    long long offset = -1;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_readv", nargs, 2, 4)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || (nargs > 3 && !Arg_int(args[3], &flags))) {
+        return NULL;
+    }
+    bufs = args[1];
+    if (Sqe_build_iovecs(self, bufs, 1, offset) < 0) {
+        return NULL;
+    }
+    io_uring_prep_readv2(self->sqe, fd, self->iovecs, self->niov, (__u64) offset, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_writev_doc,
+        "prep_writev(fd, buffers[, offset[, flags]]) -> None\n\n"
+        "Issue the equivalent of a pwritev2(2) system call, gathering data from\n"
+        "a sequence of buffers. flags are os.RWF_*, offset -1 writes at file\n"
+        "position. result is the total number of bytes written.");
+
+static PyObject *
+Sqe_prep_writev(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *bufs;
+    int fd, flags = 0;
+    long long offset = -1;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_writev", nargs, 2, 4)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || (nargs > 3 && !Arg_int(args[3], &flags))) {
+        return NULL;
+    }
+    bufs = args[1];
+    if (Sqe_build_iovecs(self, bufs, 0, offset) < 0) {
+        return NULL;
+    }
+    io_uring_prep_writev2(self->sqe, fd, self->iovecs, self->niov, (__u64) offset, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+// index of the registered buffer which view lies in, -1 on error
+static int
+BufferPool_buffer_index(Py_buffer *view)
+{
+    PyObject *obj = view->obj;
+    BufferPoolObject *pool;
+    Py_ssize_t offset;
+    Py_ssize_t index;
+
+    if (obj != NULL && PyMemoryView_Check(obj)) {
+        obj = PyMemoryView_GET_BASE(obj);
+    }
+    if (obj == NULL || !PyObject_TypeCheck(obj, &BufferPoolType)) {
+        PyErr_SetString(PyExc_ValueError, "buffer is not allocated from BufferPool");
+        return -1;
+    }
+    pool = (BufferPoolObject *) obj;
+    if (pool->ring->buffer_pool != pool) {
+        PyErr_SetString(PyExc_ValueError, "BufferPool is not registered to the ring");
+        return -1;
+    }
+    offset = (char *) view->buf - pool->base;
+    index = offset / pool->size;
+    if (view->len > (index + 1) * pool->size - offset) {
+        PyErr_SetString(PyExc_ValueError, "buffer spans more than one registered buffer");
+        return -1;
+    }
+    return (int) index;
+}
+
+PyDoc_STRVAR(
+        prep_read_fixed_doc,
+        "prep_read_fixed(fd, buf[, offset]) -> None\n\n"
+        "Issue the equivalent of a pread(2) into buf, which is a slice of BufferPool.");
+
+static PyObject *
+Sqe_prep_read_fixed(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, index;
+    long long offset = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_read_fixed", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || !Arg_buffer(args[1], &self->user_buffer, PyBUF_WRITABLE, "prep_read_fixed", 1)) {
+        return NULL;
+    }
+    if (!Sqe_check_buffer_len(self)) {
+        return NULL;
+    }
+    index = BufferPool_buffer_index(&self->user_buffer);
+    if (index < 0) {
+        Sqe_reinit_buffer(self);
+        return NULL;
+    }
+    io_uring_prep_read_fixed(self->sqe, fd, self->user_buffer.buf,
+            (unsigned) self->user_buffer.len, (__u64) offset, index);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_write_fixed_doc,
+        "prep_write_fixed(fd, buf[, offset]) -> None\n\n"
+        "Issue the equivalent of a pwrite(2) from buf, which is a slice of BufferPool.");
+
+static PyObject *
+Sqe_prep_write_fixed(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, index;
+    long long offset = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_write_fixed", nargs, 2, 3)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 2 && !Arg_longlong(args[2], &offset))
+            || !Arg_buffer(args[1], &self->user_buffer, 0, "prep_write_fixed", 1)) {
+        return NULL;
+    }
+    if (!Sqe_check_buffer_len(self)) {
+        return NULL;
+    }
+    index = BufferPool_buffer_index(&self->user_buffer);
+    if (index < 0) {
+        Sqe_reinit_buffer(self);
+        return NULL;
+    }
+    io_uring_prep_write_fixed(self->sqe, fd, self->user_buffer.buf,
+            (unsigned) self->user_buffer.len, (__u64) offset, index);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_nop_doc,
+        "prep_nop() -> None\n\n"
+        );
+
+static PyObject *
+Sqe_prep_nop(SqeObject *self)
+{
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    io_uring_prep_nop(self->sqe);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_timeout_doc,
+        "prep_timeout(timeout[, count[, flags]]) -> None\n\n"
+        "prepare a timeout operation, it completes after timeout seconds or count\n"
+        "other completions. each one is a kernel timer, TimerWheel keeps many timers\n"
+        "with one.");
+
+static PyObject *
+Sqe_prep_timeout(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    double timeout;
+    unsigned int count= 0, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_timeout", nargs, 1, 3)
+            || !Arg_double(args[0], &timeout)
+            || (nargs > 1 && !Arg_uint(args[1], &count))
+            || (nargs > 2 && !Arg_uint(args[2], &flags))) {
+        return NULL;
+    }
+    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, sizeof(struct __kernel_timespec));
+    if (self->allocated_buffer == NULL) {
+        return NULL;
+    }
+    struct __kernel_timespec *ts = (struct __kernel_timespec *) PyBytes_AS_STRING(self->allocated_buffer);
+    ts->tv_sec = (long long) timeout;
+    ts->tv_nsec = (long long) ((timeout - ts->tv_sec) * 1e9);
+    io_uring_prep_timeout(self->sqe, ts, count, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_link_timeout_doc,
+        "prep_link_timeout(timeout[, flags]) -> None\n\n"
+        "cancel the previous sqe, which must be flagged by IOSQE_IO_LINK, if it\n"
+        "has not completed in timeout seconds. res is -ETIME when it fires,\n"
+        "-EALREADY when cancelling has started and -ECANCELED if the previous\n"
+        "sqe completes in time.");
+
+static PyObject *
+Sqe_prep_link_timeout(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    double timeout;
+    unsigned int flags = 0;
+    struct __kernel_timespec *ts;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_link_timeout", nargs, 1, 2)
+            || !Arg_double(args[0], &timeout)
+            || (nargs > 1 && !Arg_uint(args[1], &flags))) {
+        return NULL;
+    }
+    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, sizeof(struct __kernel_timespec));
+    if (self->allocated_buffer == NULL) {
+        return NULL;
+    }
+    ts = (struct __kernel_timespec *) PyBytes_AS_STRING(self->allocated_buffer);
+    ts->tv_sec = (long long) timeout;
+    ts->tv_nsec = (long long) ((timeout - ts->tv_sec) * 1e9);
+    io_uring_prep_link_timeout(self->sqe, ts, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_timeout_remove_doc,
+        "prep_timeout_remove(sqe[, flags]) -> None\n\n"
+        "prepare an attempt to remove an existing timeout operation.");
+
+static PyObject *
+Sqe_prep_timeout_remove(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    SqeObject *timeout;
+    unsigned flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    if (!Args_check("prep_timeout_remove", nargs, 1, 2)
+            || !Arg_type(args[0], &SqeType, "prep_timeout_remove", 0)
+            || (nargs > 1 && !Arg_uint(args[1], &flags))) {
+        return NULL;
+    }
+    timeout = (SqeObject *) args[0];
+    io_uring_prep_timeout_remove(self->sqe, timeout->user_data, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_cancel_doc,
+        "prep_cancel(sqe) -> None\n\n"
+        "prep an operation to cancel submitted operation.");
+
+static PyObject *
+Sqe_prep_cancel(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    SqeObject *cancel;
+    unsigned flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    if (!Args_check("prep_cancel", nargs, 2, 2)
+            || !Arg_type(args[0], &SqeType, "prep_cancel", 0)
+            || !Arg_uint(args[1], &flags)) {
+        return NULL;
+    }
+    cancel = (SqeObject *) args[0];
+    io_uring_prep_cancel64(self->sqe, cancel->user_data, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_close_doc,
+        "prep_close(fd) -> None\n\n"
+        "prepare an operation to close fd.");
+
+static PyObject *
+Sqe_prep_close(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    if (!Args_check("prep_close", nargs, 1, 1)
+            || !Arg_int(args[0], &fd)) {
+        return NULL;
+    }
+    io_uring_prep_close(self->sqe, fd);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_close_direct_doc,
+        "prep_close_direct(file_index) -> None\n\n"
+        "prepare an operation to close slot file_index of registered files.");
+
+static PyObject *
+Sqe_prep_close_direct(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    unsigned file_index;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    if (!Args_check("prep_close_direct", nargs, 1, 1)
+            || !Arg_uint(args[0], &file_index)) {
+        return NULL;
+    }
+    io_uring_prep_close_direct(self->sqe, file_index);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_send_msg_doc,
+        "prep_send_msg(ring, data[, res]) -> None\n\n"
+        "post a completion to another IoUring by IORING_OP_MSG_RING, it is harvested\n"
+        "there as (data, res, 0), res is 0 by default. result of this sqe is 0, or\n"
+        "negative errno when the message could not be posted.");
+
+static PyObject *
+Sqe_prep_send_msg(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    IoUringObject *target;
+    SqeObject *msg;
+    int res = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_send_msg", nargs, 2, 3)
+            || !Arg_type(args[0], &IoUringType, "prep_send_msg", 0)
+            || (nargs > 2 && !Arg_int(args[2], &res))) {
+        return NULL;
+    }
+    target = (IoUringObject *) args[0];
+    if (target->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "target IoUring is not initialized");
+        return NULL;
+    }
+    // the message completes in a slot of target, which carries data there
+    msg = IoUring_acquire_slot(target);
+    if (msg == NULL) {
+        return NULL;
+    }
+    msg->operation = IORING_OP_MSG_RING;
+    Py_INCREF(args[1]);
+    Py_SETREF(msg->data, args[1]);
+    io_uring_prep_msg_ring(self->sqe, target->ring->ring_fd, res, msg->user_data, 0);
+    Py_INCREF(target);
+    self->allocated_buffer = (PyObject *) target;
+    self->msg_user_data = msg->user_data;
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_splice_doc,
+        "prep_splice(fd_in, off_in, fd_out, off_out, nbytes[, flags]) -> None\n\n"
+        "Issue the equivalent of a splice(2) system call, one of the fds must be a pipe.\n"
+        "offset -1 means the current file position, flags are SPLICE_F_*.");
+
+static PyObject *
+Sqe_prep_splice(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd_in, fd_out;
+    long long off_in, off_out;
+    unsigned nbytes, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_splice", nargs, 5, 6)
+            || !Arg_int(args[0], &fd_in)
+            || !Arg_longlong(args[1], &off_in)
+            || !Arg_int(args[2], &fd_out)
+            || !Arg_longlong(args[3], &off_out)
+            || !Arg_uint(args[4], &nbytes)
+            || (nargs > 5 && !Arg_uint(args[5], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_splice(self->sqe, fd_in, off_in, fd_out, off_out, nbytes, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_tee_doc,
+        "prep_tee(fd_in, fd_out, nbytes[, flags]) -> None\n\n"
+        "Issue the equivalent of a tee(2) system call, duplicate up to nbytes\n"
+        "of pipe fd_in into pipe fd_out without consuming them.");
+
+static PyObject *
+Sqe_prep_tee(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd_in, fd_out;
+    unsigned nbytes, flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_tee", nargs, 3, 4)
+            || !Arg_int(args[0], &fd_in)
+            || !Arg_int(args[1], &fd_out)
+            || !Arg_uint(args[2], &nbytes)
+            || (nargs > 3 && !Arg_uint(args[3], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_tee(self->sqe, fd_in, fd_out, nbytes, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+// store prefix bytes followed by nul terminated paths in allocated_buffer,
+// kernel may read them any time until completion. paths are bytes made
+// by PyUnicode_FSConverter, their addresses are returned in out.
+static char *
+Sqe_store_paths(SqeObject *self, Py_ssize_t prefix, PyObject **paths, const char **out, int n)
+{
+    Py_ssize_t size = prefix;
+    char *base, *p;
+
+    for (int i = 0; i < n; i++) {
+        size += PyBytes_GET_SIZE(paths[i]) + 1;
+    }
+    self->allocated_buffer = PyBytes_FromStringAndSize(NULL, size);
+    if (self->allocated_buffer == NULL) {
+        return NULL;
+    }
+    base = PyBytes_AS_STRING(self->allocated_buffer);
+    p = base + prefix;
+    for (int i = 0; i < n; i++) {
+        memcpy(p, PyBytes_AS_STRING(paths[i]), PyBytes_GET_SIZE(paths[i]) + 1);
+        out[i] = p;
+        p += PyBytes_GET_SIZE(paths[i]) + 1;
+    }
+    return base;
+}
+
+PyDoc_STRVAR(
+        prep_openat_doc,
+        "prep_openat(path, flags[, mode[, dir_fd]]) -> None\n\n"
+        "Issue the equivalent of a openat(2) system call, result is the new fd.\n"
+        "dir_fd defaults to AT_FDCWD.");
+
+static PyObject *
+Sqe_prep_openat(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *path;
+    const char *cpath;
+    char *stored;
+    int flags, mode = 0777, dir_fd = AT_FDCWD;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_openat", nargs, 2, 4)
+            || !Arg_int(args[1], &flags)
+            || (nargs > 2 && !Arg_int(args[2], &mode))
+            || (nargs > 3 && !Arg_int(args[3], &dir_fd))
+            || !PyUnicode_FSConverter(args[0], &path)) {
+        return NULL;
+    }
+    stored = Sqe_store_paths(self, 0, &path, &cpath, 1);
+    Py_DECREF(path);
+    if (stored == NULL) {
+        return NULL;
+    }
+    io_uring_prep_openat(self->sqe, dir_fd, cpath, flags, mode);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_statx_doc,
+        "prep_statx(path[, flags[, mask[, dir_fd]]]) -> None\n\n"
+        "Issue the equivalent of a statx(2) system call, result is a StatxResult.\n"
+        "flags are AT_*, mask defaults to STATX_BASIC_STATS, dir_fd to AT_FDCWD.\n"
+        "with path '' and flags AT_EMPTY_PATH dir_fd itself is stated.");
+
+static PyObject *
+Sqe_prep_statx(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *path;
+    const char *cpath;
+    char *statxbuf;
+    int flags = 0, dir_fd = AT_FDCWD;
+    unsigned mask = STATX_BASIC_STATS;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_statx", nargs, 1, 4)
+            || (nargs > 1 && !Arg_int(args[1], &flags))
+            || (nargs > 2 && !Arg_uint(args[2], &mask))
+            || (nargs > 3 && !Arg_int(args[3], &dir_fd))
+            || !PyUnicode_FSConverter(args[0], &path)) {
+        return NULL;
+    }
+    statxbuf = Sqe_store_paths(self, sizeof(struct statx), &path, &cpath, 1);
+    Py_DECREF(path);
+    if (statxbuf == NULL) {
+        return NULL;
+    }
+    io_uring_prep_statx(self->sqe, dir_fd, cpath, flags, mask, (struct statx *) statxbuf);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Sqe_statx_result(SqeObject *self)
+{
+    struct statx *stx = (struct statx *) PyBytes_AS_STRING(self->allocated_buffer);
+    PyObject *result = PyStructSequence_New(&StatxResultType);
+    int i = 0;
+
+    if (result == NULL) {
+        return NULL;
+    }
+#define SET_ITEM(obj) do { \
+    PyObject *item = (obj); \
+    if (item == NULL) { \
+        Py_DECREF(result); \
+        return NULL; \
+    } \
+    PyStructSequence_SET_ITEM(result, i++, item); \
+} while (0)
+#define TIMESTAMP_NS(ts) PyLong_FromLongLong((ts).tv_sec * 1000000000LL + (ts).tv_nsec)
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_mask));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_blksize));
+    SET_ITEM(PyLong_FromUnsignedLongLong(stx->stx_attributes));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_nlink));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_uid));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_gid));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_mode));
+    SET_ITEM(PyLong_FromUnsignedLongLong(stx->stx_ino));
+    SET_ITEM(PyLong_FromUnsignedLongLong(stx->stx_size));
+    SET_ITEM(PyLong_FromUnsignedLongLong(stx->stx_blocks));
+    SET_ITEM(PyLong_FromUnsignedLongLong(stx->stx_attributes_mask));
+    SET_ITEM(TIMESTAMP_NS(stx->stx_atime));
+    SET_ITEM(TIMESTAMP_NS(stx->stx_btime));
+    SET_ITEM(TIMESTAMP_NS(stx->stx_ctime));
+    SET_ITEM(TIMESTAMP_NS(stx->stx_mtime));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_rdev_major));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_rdev_minor));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_dev_major));
+    SET_ITEM(PyLong_FromUnsignedLong(stx->stx_dev_minor));
+#undef TIMESTAMP_NS
+#undef SET_ITEM
+    return result;
+}
+
+PyDoc_STRVAR(
+        prep_fsync_doc,
+        "prep_fsync(fd[, flags]) -> None\n\n"
+        "Issue the equivalent of a fsync(2) system call, or fdatasync(2) with\n"
+        "flags IORING_FSYNC_DATASYNC.");
+
+static PyObject *
+Sqe_prep_fsync(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd;
+    unsigned flags = 0;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_fsync", nargs, 1, 2)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 1 && !Arg_uint(args[1], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_fsync(self->sqe, fd, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_sync_file_range_doc,
+        "prep_sync_file_range(fd, offset, nbytes[, flags]) -> None\n\n"
+        "Issue the equivalent of a sync_file_range(2) system call, flags are\n"
+        "SYNC_FILE_RANGE_*.");
+
+static PyObject *
+Sqe_prep_sync_file_range(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, flags = 0;
+    long long offset;
+    unsigned nbytes;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_sync_file_range", nargs, 3, 4)
+            || !Arg_int(args[0], &fd)
+            || !Arg_longlong(args[1], &offset)
+            || !Arg_uint(args[2], &nbytes)
+            || (nargs > 3 && !Arg_int(args[3], &flags))) {
+        return NULL;
+    }
+    io_uring_prep_sync_file_range(self->sqe, fd, nbytes, (__u64) offset, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_fallocate_doc,
+        "prep_fallocate(fd, mode, offset, len) -> None\n\n"
+        "Issue the equivalent of a fallocate(2) system call, mode is FALLOC_FL_*.");
+
+static PyObject *
+Sqe_prep_fallocate(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    int fd, mode;
+    long long offset, len;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_fallocate", nargs, 4, 4)
+            || !Arg_int(args[0], &fd)
+            || !Arg_int(args[1], &mode)
+            || !Arg_longlong(args[2], &offset)
+            || !Arg_longlong(args[3], &len)) {
+        return NULL;
+    }
+    io_uring_prep_fallocate(self->sqe, fd, mode, (__u64) offset, (__u64) len);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_unlinkat_doc,
+        "prep_unlinkat(path[, flags[, dir_fd]]) -> None\n\n"
+        "Issue the equivalent of a unlinkat(2) system call, flags AT_REMOVEDIR\n"
+        "removes a directory.");
+
+static PyObject *
+Sqe_prep_unlinkat(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *path;
+    const char *cpath;
+    char *stored;
+    int flags = 0, dir_fd = AT_FDCWD;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_unlinkat", nargs, 1, 3)
+            || (nargs > 1 && !Arg_int(args[1], &flags))
+            || (nargs > 2 && !Arg_int(args[2], &dir_fd))
+            || !PyUnicode_FSConverter(args[0], &path)) {
+        return NULL;
+    }
+    stored = Sqe_store_paths(self, 0, &path, &cpath, 1);
+    Py_DECREF(path);
+    if (stored == NULL) {
+        return NULL;
+    }
+    io_uring_prep_unlinkat(self->sqe, dir_fd, cpath, flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        prep_renameat_doc,
+        "prep_renameat(src, dst[, flags[, src_dir_fd[, dst_dir_fd]]]) -> None\n\n"
+        "Issue the equivalent of a renameat2(2) system call, flags are RENAME_*.");
+
+static PyObject *
+Sqe_prep_renameat(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *paths[2] = {NULL, NULL};
+    const char *cpaths[2];
+    unsigned flags = 0;
+    int src_dir_fd = AT_FDCWD, dst_dir_fd = AT_FDCWD;
+    char *stored;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    Sqe_reinit_buffer(self);
+    if (!Args_check("prep_renameat", nargs, 2, 5)
+            || (nargs > 2 && !Arg_uint(args[2], &flags))
+            || (nargs > 3 && !Arg_int(args[3], &src_dir_fd))
+            || (nargs > 4 && !Arg_int(args[4], &dst_dir_fd))
+            || !PyUnicode_FSConverter(args[0], &paths[0])
+            || !PyUnicode_FSConverter(args[1], &paths[1])) {
+        Py_XDECREF(paths[0]);
+        return NULL;
+    }
+    stored = Sqe_store_paths(self, 0, paths, cpaths, 2);
+    Py_DECREF(paths[0]);
+    Py_DECREF(paths[1]);
+    if (stored == NULL) {
+        return NULL;
+    }
+    io_uring_prep_renameat(self->sqe, src_dir_fd, cpaths[0], dst_dir_fd, cpaths[1], flags);
+    self->operation = self->sqe->opcode;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        set_fixed_file_doc,
+        "set_fixed_file() -> None\n\n"
+        "treat fd of the prepared operation as an index into registered files,\n"
+        "must be called after prep_*.");
+
+static PyObject *
+Sqe_set_fixed_file(SqeObject *self)
+{
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    self->sqe->flags |= IOSQE_FIXED_FILE;
+    Py_RETURN_NONE;
+}
+
+// IOSQE_CQE_SKIP_SUCCESS would leave the slot without completion
+// and IOSQE_BUFFER_SELECT belongs to prep_recv_select
+#define SQE_USER_FLAGS (IOSQE_FIXED_FILE | IOSQE_IO_DRAIN | IOSQE_IO_LINK \
+        | IOSQE_IO_HARDLINK | IOSQE_ASYNC)
+
+PyDoc_STRVAR(
+        set_flags_doc,
+        "set_flags(flags) -> None\n\n"
+        "add IOSQE_FIXED_FILE, IOSQE_IO_DRAIN, IOSQE_IO_LINK, IOSQE_IO_HARDLINK\n"
+        "or IOSQE_ASYNC to the prepared operation, must be called after prep_*.\n"
+        "sqes linked by IOSQE_IO_LINK must be submitted by the same submit().");
+
+static PyObject *
+Sqe_set_flags(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    unsigned flags;
+
+    if (!Sqe_acquired(self)) {
+        return NULL;
+    }
+    if (!Args_check("set_flags", nargs, 1, 1)
+            || !Arg_uint(args[0], &flags)) {
+        return NULL;
+    }
+    if (flags & ~SQE_USER_FLAGS) {
+        PyErr_Format(PyExc_ValueError, "unsupported sqe flags: 0x%x", flags & ~SQE_USER_FLAGS);
+        return NULL;
+    }
+    self->sqe->flags |= flags;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        set_data_doc,
+        "set_data(data) -> None\n\n"
+        "set the data related to this sqe, can be reached by related cqe.");
+
+static PyObject *
+Sqe_set_data(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *data;
+    if (!Args_check("set_data", nargs, 1, 1)) {
+        return NULL;
+    }
+    data = args[0];
+    Py_INCREF(data);
+    Py_DECREF(self->data);
+    self->data = data;
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        set_callback_doc,
+        "set_callback(callback, *args) -> None\n\n"
+        "IoUring.run calls callback(res, *args) for each completion of this sqe.");
+
+static PyObject *
+Sqe_set_callback(SqeObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *cbargs = NULL;
+
+    if (!Args_check("set_callback", nargs, 1, PY_SSIZE_T_MAX)) {
+        return NULL;
+    }
+    if (!PyCallable_Check(args[0])) {
+        PyErr_Format(PyExc_TypeError, "set_callback() argument 1 must be callable, not %.50s",
+                Py_TYPE(args[0])->tp_name);
+        return NULL;
+    }
+    if (nargs > 1) {
+        cbargs = PyTuple_New(nargs - 1);
+        if (cbargs == NULL) {
+            return NULL;
+        }
+        for (Py_ssize_t i = 1; i < nargs; i++) {
+            Py_INCREF(args[i]);
+            PyTuple_SET_ITEM(cbargs, i - 1, args[i]);
+        }
+    }
+    Py_INCREF(args[0]);
+    Py_XSETREF(self->callback, args[0]);
+    Py_XSETREF(self->cbargs, cbargs);
+    Py_RETURN_NONE;
+}
+
+// prepare self from an (opcode, fd, buf, offset, flags, data) tuple given to
+// submit_ops, by the prep_* method the opcode corresponds to.
+static int
+Sqe_prep_record(SqeObject *self, PyObject *record)
+{
+    PyObject **item, *ret;
+    int opcode;
+
+    if (!PyTuple_Check(record) || PyTuple_GET_SIZE(record) != 6) {
+        PyErr_Format(PyExc_TypeError,
+                "submit_ops() expects (opcode, fd, buf, offset, flags, data) tuples, not %.50s",
+                Py_TYPE(record)->tp_name);
+        return -1;
+    }
+    item = &PyTuple_GET_ITEM(record, 0);
+    if (!Arg_int(item[0], &opcode)) {
+        return -1;
+    }
+    // fd, buf, offset are laid out as prep_* arguments
+    switch (opcode) {
+        case IORING_OP_NOP:
+            ret = Sqe_prep_nop(self);
+            break;
+        case IORING_OP_READ:
+            ret = PyLong_Check(item[2])
+                ? Sqe_prep_read(self, item + 1, 3)
+                : Sqe_prep_read_into(self, item + 1, 3);
+            break;
+        case IORING_OP_WRITE:
+            ret = Sqe_prep_write(self, item + 1, 3);
+            break;
+        case IORING_OP_READV:
+            ret = Sqe_prep_readv(self, item + 1, 3);
+            break;
+        case IORING_OP_WRITEV:
+            ret = Sqe_prep_writev(self, item + 1, 3);
+            break;
+        case IORING_OP_RECV:
+            ret = PyLong_Check(item[2])
+                ? Sqe_prep_recv(self, item + 1, 2)
+                : Sqe_prep_recv_into(self, item + 1, 2);
+            break;
+        case IORING_OP_SEND:
+            ret = Sqe_prep_send(self, item + 1, 2);
+            break;
+        case IORING_OP_FSYNC:
+            ret = Sqe_prep_fsync(self, item + 1, 1);
+            break;
+        case IORING_OP_CLOSE:
+            ret = Sqe_prep_close(self, item + 1, 1);
+            break;
+        default:
+            PyErr_Format(PyExc_ValueError, "submit_ops() does not support opcode %d", opcode);
+            return -1;
+    }
+    if (ret == NULL) {
+        return -1;
+    }
+    Py_DECREF(ret);
+    ret = Sqe_set_flags(self, item + 4, 1);
+    if (ret == NULL) {
+        return -1;
+    }
+    Py_DECREF(ret);
+    Py_INCREF(item[5]);
+    Py_SETREF(self->data, item[5]);
+    return 0;
+}
+
+// CqeObject methods definitions
+static PyObject *
+Cqe_new(PyTypeObject *type, PyObject *args, PyObject *kwlist)
+{
+    CqeObject *self;
+    self = (CqeObject *) (type->tp_alloc(type, 0));
+    if (self != NULL) {
+        self->seen = false;
+        self->result = NULL;
+        self->next = NULL;
+    } else {
+        return NULL;
+    }
+    return (PyObject*) self;
+}
+
+static void
+Cqe_dealloc(CqeObject *self)
+{
+    // when user keep an reference to related sqeobj
+    // the specified sqeobj won't be gc, and also this
+    // cqe may not call cqe_seen method, so we unlink it
+    // from sqeobj's cqeobj list, to allow new one can be
+    // created by wait cqe or peek cqe method without
+    // segmentfault caused by an invalid cqeobj pointer
+    Sqe_unlink_cqe(self->sqeobj, self);
+    Py_XDECREF((PyObject *) self->sqeobj);
+    Py_XDECREF(self->result);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyDoc_STRVAR(
+        get_data_doc,
+        "get_data() -> any\n\n"
+        "get data set in related sqe.");
+
+static PyObject *
+Cqe_get_data(CqeObject *self, PyObject *args)
+{
+    PyObject *data = (PyObject *) self->sqeobj->data;
+    Py_INCREF(data);
+    return data;
+}
+
+PyDoc_STRVAR(
+        res_doc,
+        "res() -> int\n\n"
+        "operation res.");
+
+static PyObject *
+Cqe_res(CqeObject *self, PyObject *args)
+{
+    return PyLong_FromLong(self->res);
+}
+
+static PyObject *ProvidedBuffer_new(BufferRingObject *bufring, unsigned short bid, int len);
+
+// convert successful res of the operation described by this sqe
+static PyObject *
+Sqe_getresult(SqeObject *self, int res, unsigned flags)
+{
+    switch (self->operation) {
+        case IORING_OP_NOP:
+            Py_RETURN_NONE;
+        case IORING_OP_STATX:
+            return Sqe_statx_result(self);
+        case IORING_OP_ACCEPT:
+            if (self->accept_mode == ACCEPT_RESULT_ADDR) {
+                PyObject *addr = Sqe_address_object(self);
+                if (addr == NULL) {
+                    return NULL;
+                }
+                return Py_BuildValue("iN", res, addr);
+            }
+            return PyLong_FromLong(res);
+        case IORING_OP_READ:
+        case IORING_OP_RECV:
+            // read into user buffer, only the number of bytes matters
+            if (self->allocated_buffer == NULL) {
+                return PyLong_FromLong(res);
+            }
+            if (PyObject_TypeCheck(self->allocated_buffer, &BufferRingType)) {
+                // kernel does not select a buffer for end of stream
+                if (!(flags & IORING_CQE_F_BUFFER)) {
+                    return PyBytes_FromStringAndSize(NULL, 0);
+                }
+                return ProvidedBuffer_new((BufferRingObject *) self->allocated_buffer,
+                        flags >> IORING_CQE_BUFFER_SHIFT, res);
+            }
+            if (res != PyBytes_GET_SIZE(self->allocated_buffer)
+                    && _PyBytes_Resize(&(self->allocated_buffer), res)) {
+                return NULL;
+            }
+            Py_INCREF(self->allocated_buffer);
+            return self->allocated_buffer;
+        default:
+            return PyLong_FromLong(res);
+    }
+}
+
+static PyObject *
+Cqe_getresult(CqeObject *self)
+{
+    int res = self->res;
+    if (res < 0) {
+        errno = -res;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (self->result == NULL) {
+        self->result = Sqe_getresult(self->sqeobj, res, self->flags);
+        if (self->result == NULL) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->result);
+    return self->result;
+}
+
+// BufferPoolObject methods definitions
+
+static PyObject *
+BufferPool_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    BufferPoolObject *self;
+    IoUringObject *ring;
+    unsigned nbufs;
+    Py_ssize_t size, page_size = sysconf(_SC_PAGESIZE);
+    struct iovec *iovecs;
+    int ret;
+
+    if (!Args_check("BufferPool", nargs, 3, 3)
+            || !Arg_type(args[0], &IoUringType, "BufferPool", 0)
+            || !Arg_uint(args[1], &nbufs)
+            || !Arg_ssize(args[2], &size)) {
+        return NULL;
+    }
+    ring = (IoUringObject *) args[0];
+    if (ring->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (nbufs == 0 || size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "BufferPool needs at least one non empty buffer");
+        return NULL;
+    }
+    // keep every buffer page aligned
+    size = (size + page_size - 1) / page_size * page_size;
+    if (size > PY_SSIZE_T_MAX / nbufs) {
+        return PyErr_NoMemory();
+    }
+    self = (BufferPoolObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    Py_INCREF(ring);
+    self->ring = ring;
+    self->size = size;
+    self->nbufs = nbufs;
+    self->exports = 0;
+    self->base = mmap(NULL, size * nbufs, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->base == MAP_FAILED) {
+        self->base = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    iovecs = PyMem_New(struct iovec, nbufs);
+    if (iovecs == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (unsigned i = 0; i < nbufs; i++) {
+        iovecs[i].iov_base = self->base + i * size;
+        iovecs[i].iov_len = size;
+    }
+    // kernel pins every page here, which may take a while for large pools
+    Py_BEGIN_ALLOW_THREADS
+    ret = io_uring_register_buffers(ring->ring, iovecs, nbufs);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(iovecs);
+    if (ret < 0) {
+        errno = -ret;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    ring->buffer_pool = self;
+    return (PyObject *) self;
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject *
+BufferPool_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("BufferPool", kwargs)) {
+        return NULL;
+    }
+    return BufferPool_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+BufferPool_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("BufferPool", kwnames)) {
+        return NULL;
+    }
+    return BufferPool_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+// unregister from ring and unmap memory, buffers must not be exported
+static int
+BufferPool_close_impl(BufferPoolObject *self)
+{
+    int ret = 0;
+
+    if (self->ring->buffer_pool == self) {
+        ret = io_uring_unregister_buffers(self->ring->ring);
+        self->ring->buffer_pool = NULL;
+    }
+    if (self->base != NULL) {
+        munmap(self->base, self->size * self->nbufs);
+        self->base = NULL;
+    }
+    return ret;
+}
+
+static void
+BufferPool_dealloc(BufferPoolObject *self)
+{
+    if (self->ring != NULL) {
+        BufferPool_close_impl(self);
+        Py_DECREF(self->ring);
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyDoc_STRVAR(
+        buffer_pool_close_doc,
+        "close() -> None\n\n"
+        "unregister buffers from ring and release the memory.");
+
+static PyObject *
+BufferPool_close(BufferPoolObject *self)
+{
+    int ret;
+
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot close BufferPool: buffers are still in use");
+        return NULL;
+    }
+    ret = BufferPool_close_impl(self);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(
+        buffer_pool_buffer_doc,
+        "buffer(index) -> memoryview\n\n"
+        "return a writable memoryview of registered buffer index.");
+
+static PyObject *
+BufferPool_buffer(BufferPoolObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    unsigned index;
+    PyObject *view;
+
+    if (!Args_check("buffer", nargs, 1, 1)
+            || !Arg_uint(args[0], &index)) {
+        return NULL;
+    }
+    if (index >= self->nbufs) {
+        PyErr_SetString(PyExc_IndexError, "buffer index out of range");
+        return NULL;
+    }
+    view = PyMemoryView_FromObject((PyObject *) self);
+    if (view == NULL) {
+        return NULL;
+    }
+    // slices share the export of view, so pool can not be closed under them
+    Py_SETREF(view, PySequence_GetSlice(view, index * self->size, (index + 1) * self->size));
+    return view;
+}
+
+static Py_ssize_t
+BufferPool_length(BufferPoolObject *self)
+{
+    return self->nbufs;
+}
+
+static int
+BufferPool_getbuffer(BufferPoolObject *self, Py_buffer *view, int flags)
+{
+    if (self->base == NULL) {
+        PyErr_SetString(PyExc_ValueError, "BufferPool is closed");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->base,
+                self->size * self->nbufs, 0, flags) < 0) {
+        return -1;
+    }
+    self->exports++;
+    return 0;
+}
+
+static void
+BufferPool_releasebuffer(BufferPoolObject *self, Py_buffer *view)
+{
+    self->exports--;
+}
+
+// BufferRingObject methods definitions
+
+static PyObject *
+BufferRing_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    BufferRingObject *self;
+    IoUringObject *ring;
+    struct io_uring_buf_reg reg;
+    unsigned nbufs;
+    Py_ssize_t size;
+    int bgid, ret;
+
+    if (!Args_check("BufferRing", nargs, 4, 4)
+            || !Arg_type(args[0], &IoUringType, "BufferRing", 0)
+            || !Arg_int(args[1], &bgid)
+            || !Arg_uint(args[2], &nbufs)
+            || !Arg_ssize(args[3], &size)) {
+        return NULL;
+    }
+    ring = (IoUringObject *) args[0];
+    if (ring->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (nbufs == 0 || nbufs > 32768 || (nbufs & (nbufs - 1))) {
+        PyErr_SetString(PyExc_ValueError, "number of buffers must be a power of 2 up to 32768");
+        return NULL;
+    }
+    if (size <= 0 || size > UINT_MAX || bgid < 0 || bgid > USHRT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "invalid buffer size or group id");
+        return NULL;
+    }
+    if (size > PY_SSIZE_T_MAX / nbufs) {
+        return PyErr_NoMemory();
+    }
+    self = (BufferRingObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    Py_INCREF(ring);
+    self->ring = ring;
+    self->size = size;
+    self->nbufs = nbufs;
+    self->bgid = bgid;
+    self->outstanding = 0;
+    self->br = NULL;
+    self->base = mmap(NULL, size * nbufs, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->base == MAP_FAILED) {
+        self->base = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    // ring shared with kernel must be page aligned
+    self->br = mmap(NULL, nbufs * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->br == MAP_FAILED) {
+        self->br = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long) self->br;
+    reg.ring_entries = nbufs;
+    reg.bgid = bgid;
+    ret = io_uring_register_buf_ring(ring->ring, &reg, 0);
+    if (ret < 0) {
+        munmap(self->br, nbufs * sizeof(struct io_uring_buf));
+        self->br = NULL;
+        errno = -ret;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    io_uring_buf_ring_init(self->br);
+    for (unsigned i = 0; i < nbufs; i++) {
+        io_uring_buf_ring_add(self->br, self->base + i * size, size, i,
+                io_uring_buf_ring_mask(nbufs), i);
+    }
+    io_uring_buf_ring_advance(self->br, nbufs);
+    return (PyObject *) self;
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject *
+BufferRing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("BufferRing", kwargs)) {
+        return NULL;
+    }
+    return BufferRing_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+BufferRing_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("BufferRing", kwnames)) {
+        return NULL;
+    }
+    return BufferRing_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+// give buffer bid back to kernel
+static void
+BufferRing_recycle(BufferRingObject *self, unsigned short bid)
+{
+    if (self->br == NULL) {
+        return;
+    }
+    io_uring_buf_ring_add(self->br, self->base + bid * self->size, self->size, bid,
+            io_uring_buf_ring_mask(self->nbufs), 0);
+    io_uring_buf_ring_advance(self->br, 1);
+}
+
+static int
+BufferRing_close_impl(BufferRingObject *self)
+{
+    int ret = 0;
+
+    if (self->br != NULL) {
+        // buffer rings are dropped by kernel along with the ring itself
+        if (self->ring->slots != NULL) {
+            ret = io_uring_unregister_buf_ring(self->ring->ring, self->bgid);
+        }
+        munmap(self->br, self->nbufs * sizeof(struct io_uring_buf));
+        self->br = NULL;
+    }
+    if (self->base != NULL) {
+        munmap(self->base, self->size * self->nbufs);
+        self->base = NULL;
+    }
+    return ret;
+}
+
+static void
+BufferRing_dealloc(BufferRingObject *self)
+{
+    if (self->ring != NULL) {
+        BufferRing_close_impl(self);
+        Py_DECREF(self->ring);
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyDoc_STRVAR(
+        buffer_ring_close_doc,
+        "close() -> None\n\n"
+        "unregister buffer group from ring and release the memory.");
+
+static PyObject *
+BufferRing_close(BufferRingObject *self)
+{
+    int ret;
+
+    if (self->outstanding > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot close BufferRing: provided buffers are not released");
+        return NULL;
+    }
+    ret = BufferRing_close_impl(self);
+    if (ret < 0) {
+        errno = -ret;
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    Py_RETURN_NONE;
+}
+
+// ProvidedBufferObject methods definitions
+
+static PyObject *
+ProvidedBuffer_new(BufferRingObject *bufring, unsigned short bid, int len)
+{
+    ProvidedBufferObject *self;
+
+    if (bid >= bufring->nbufs || bufring->base == NULL) {
+        PyErr_SetString(PyExc_ValueError, "invalid provided buffer");
+        return NULL;
+    }
+    self = PyObject_New(ProvidedBufferObject, &ProvidedBufferType);
+    if (self == NULL) {
+        return NULL;
+    }
+    Py_INCREF(bufring);
+    self->bufring = bufring;
+    self->buf = bufring->base + bid * bufring->size;
+    self->len = len;
+    self->bid = bid;
+    self->exports = 0;
+    bufring->outstanding++;
+    return (PyObject *) self;
+}
+
+static void
+ProvidedBuffer_release_impl(ProvidedBufferObject *self)
+{
+    BufferRingObject *bufring = self->bufring;
+
+    if (bufring != NULL) {
+        self->bufring = NULL;
+        bufring->outstanding--;
+        BufferRing_recycle(bufring, self->bid);
+        Py_DECREF(bufring);
+    }
+}
+
+static void
+ProvidedBuffer_dealloc(ProvidedBufferObject *self)
+{
+    ProvidedBuffer_release_impl(self);
+    PyObject_Free(self);
+}
+
+PyDoc_STRVAR(
+        provided_buffer_release_doc,
+        "release() -> None\n\n"
+        "return this buffer to its BufferRing, so that kernel can select it again.");
+
+static PyObject *
+ProvidedBuffer_release(ProvidedBufferObject *self)
+{
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "cannot release ProvidedBuffer: it is still exported");
+        return NULL;
+    }
+    ProvidedBuffer_release_impl(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+ProvidedBuffer_bytes(ProvidedBufferObject *self)
+{
+    if (self->bufring == NULL) {
+        PyErr_SetString(PyExc_ValueError, "ProvidedBuffer is released");
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize(self->buf, self->len);
+}
+
+static Py_ssize_t
+ProvidedBuffer_length(ProvidedBufferObject *self)
+{
+    return self->len;
+}
+
+static int
+ProvidedBuffer_getbuffer(ProvidedBufferObject *self, Py_buffer *view, int flags)
+{
+    if (self->bufring == NULL) {
+        PyErr_SetString(PyExc_ValueError, "ProvidedBuffer is released");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->buf, self->len, 0, flags) < 0) {
+        return -1;
+    }
+    self->exports++;
+    return 0;
+}
+
+static void
+ProvidedBuffer_releasebuffer(ProvidedBufferObject *self, Py_buffer *view)
+{
+    self->exports--;
+}
+
+// AlignedBufferObject methods definitions
+
+static PyObject *
+AlignedBuffer_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    AlignedBufferObject *self;
+    Py_ssize_t size, page_size = sysconf(_SC_PAGESIZE), alignment = page_size;
+
+    if (!Args_check("AlignedBuffer", nargs, 1, 2)
+            || !Arg_ssize(args[0], &size)
+            || (nargs > 1 && !Arg_ssize(args[1], &alignment))) {
+        return NULL;
+    }
+    if (size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be positive");
+        return NULL;
+    }
+    // memory from mmap is page aligned, so is any smaller power of 2
+    if (alignment <= 0 || alignment > page_size || (alignment & (alignment - 1))) {
+        PyErr_Format(PyExc_ValueError, "alignment must be a power of 2 up to %zd", page_size);
+        return NULL;
+    }
+    if (size > PY_SSIZE_T_MAX - alignment) {
+        return PyErr_NoMemory();
+    }
+    self = (AlignedBufferObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->size = (size + alignment - 1) & ~(alignment - 1);
+    self->alignment = alignment;
+    self->exports = 0;
+    self->buf = mmap(NULL, self->size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->buf == MAP_FAILED) {
+        self->buf = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+static PyObject *
+AlignedBuffer_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("AlignedBuffer", kwargs)) {
+        return NULL;
+    }
+    return AlignedBuffer_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+AlignedBuffer_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("AlignedBuffer", kwnames)) {
+        return NULL;
+    }
+    return AlignedBuffer_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+static void
+AlignedBuffer_dealloc(AlignedBufferObject *self)
+{
+    // views of buffer keep a reference, nobody sees it now
+    if (self->buf != NULL) {
+        munmap(self->buf, self->size);
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static Py_ssize_t
+AlignedBuffer_length(AlignedBufferObject *self)
+{
+    return self->size;
+}
+
+static int
+AlignedBuffer_getbuffer(AlignedBufferObject *self, Py_buffer *view, int flags)
+{
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->buf, self->size, 0, flags) < 0) {
+        return -1;
+    }
+    self->exports++;
+    return 0;
+}
+
+static void
+AlignedBuffer_releasebuffer(AlignedBufferObject *self, Py_buffer *view)
+{
+    self->exports--;
+}
+
+// O_DIRECT fails with EINVAL on misaligned I/O, which gives no hint of
+// what is wrong. so when the buffer comes from AlignedBuffer, directly or
+// through memoryview, check it before the operation is queued.
+static int
+AlignedBuffer_check_io(Py_buffer *view, long long offset)
+{
+    PyObject *obj = view->obj;
+    Py_ssize_t alignment;
+
+    if (obj != NULL && PyMemoryView_Check(obj)) {
+        obj = PyMemoryView_GET_BASE(obj);
+    }
+    if (obj == NULL || !Py_IS_TYPE(obj, &AlignedBufferType)) {
+        return 0;
+    }
+    alignment = ((AlignedBufferObject *) obj)->alignment;
+    // offset -1 means the file position, which kernel checks
+    if ((uintptr_t) view->buf % alignment || view->len % alignment
+            || (offset > 0 && offset % alignment)) {
+        PyErr_Format(PyExc_ValueError,
+                "address, length and offset of direct I/O must be aligned to %zd", alignment);
+        return -1;
+    }
+    return 0;
+}
+
+PyDoc_STRVAR(
+        dio_alignment_doc,
+        "dio_alignment(fd) -> Tuple[int, int]\n\n"
+        "return (memory alignment, offset alignment) required by O_DIRECT I/O on fd,\n"
+        "(0, 0) if the file doesn't support it. without STATX_DIOALIGN the logical\n"
+        "block size of a block device or the block size of file system is used.");
+
+static PyObject *
+PyIoUring_dio_alignment(PyObject *module, PyObject *const *args, Py_ssize_t nargs)
+{
+    struct stat st;
+    int fd, ret, block_size;
+
+    if (!Args_check("dio_alignment", nargs, 1, 1)
+            || !Arg_int(args[0], &fd)) {
+        return NULL;
+    }
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx);
+    Py_END_ALLOW_THREADS
+    if (ret < 0) {
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (stx.stx_mask & STATX_DIOALIGN) {
+        return Py_BuildValue("(II)", stx.stx_dio_mem_align, stx.stx_dio_offset_align);
+    }
+#endif
+    Py_BEGIN_ALLOW_THREADS
+    ret = fstat(fd, &st);
+    Py_END_ALLOW_THREADS
+    if (ret < 0) {
+        return PyErr_SetFromErrno(PyExc_OSError);
+    }
+    if (S_ISBLK(st.st_mode)) {
+        if (ioctl(fd, BLKSSZGET, &block_size) < 0) {
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+        return Py_BuildValue("(ii)", block_size, block_size);
+    }
+    // a multiple of logical block size of the device, stricter but safe
+    return Py_BuildValue("(ll)", (long) st.st_blksize, (long) st.st_blksize);
+}
+
+// ProxyObject methods definitions
+
+static void
+Proxy_close_pipe(ProxyObject *self)
+{
+    for (int i = 0; i < 2; i++) {
+        if (self->pipefd[i] >= 0) {
+            close(self->pipefd[i]);
+            self->pipefd[i] = -1;
+        }
+    }
+}
+
+// queue one operation of current round, sqe space is checked by caller
+static struct io_uring_sqe *
+Proxy_queue(ProxyObject *self, int op, unsigned char sqe_flags)
+{
+    SqeObject *sqeobj;
+    struct io_uring_sqe *sqe;
+
+    sqeobj = (SqeObject *) IoUring_get_sqe(self->ring);
+    if (sqeobj == NULL) {
+        return NULL;
+    }
+    sqe = sqeobj->sqe;
+    switch (op) {
+        case PROXY_POLL_IN:
+            io_uring_prep_poll_add(sqe, self->src, POLLIN);
+            break;
+        case PROXY_SPLICE_IN:
+            io_uring_prep_splice(sqe, self->src, -1, self->pipefd[1], -1,
+                    self->pipe_size, SPLICE_F_MOVE);
+            break;
+        case PROXY_POLL_OUT:
+            io_uring_prep_poll_add(sqe, self->dst, POLLOUT);
+            break;
+        default:
+            // an empty pipe fails with EAGAIN instead of waiting for data
+            io_uring_prep_splice(sqe, self->pipefd[0], -1, self->dst, -1,
+                    self->pipe_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            break;
+    }
+    io_uring_sqe_set_flags(sqe, sqe_flags);
+    sqeobj->operation = sqe->opcode;
+    Py_INCREF(self);
+    Py_SETREF(sqeobj->data, (PyObject *) self);
+    self->user_data[op] = sqeobj->user_data;
+    self->pending++;
+    Py_DECREF(sqeobj);
+    return sqe;
+}
+
+// queue next round, [poll src] splice src to pipe => [poll dst] splice pipe
+// to dst. while data is left in pipe only the second half is queued.
+// return 1 if there is nothing left to transfer.
+static int
+Proxy_arm(ProxyObject *self)
+{
+    struct io_uring_sqe *sqe, *last = NULL;
+    PyObject *ret;
+    int ops[PROXY_OPS], nops = 0;
+    unsigned char sqe_flags;
+
+    if (self->inpipe == 0) {
+        if (self->eof) {
+            return 1;
+        }
+        if (self->poll_in) {
+            ops[nops++] = PROXY_POLL_IN;
+        }
+        ops[nops++] = PROXY_SPLICE_IN;
+    }
+    if (self->poll_out) {
+        ops[nops++] = PROXY_POLL_OUT;
+    }
+    ops[nops++] = PROXY_SPLICE_OUT;
+    // user_data of a slot never has all bits set, ops not queued match nothing
+    memset(self->user_data, 0xff, sizeof(self->user_data));
+    // a chain must not be split by a full submission queue
+    if (io_uring_sq_space_left(self->ring->ring) < (unsigned) nops) {
+        ret = IoUring_submit(self->ring);
+        if (ret == NULL) {
+            return -1;
+        }
+        Py_DECREF(ret);
+    }
+    for (int i = 0; i < nops; i++) {
+        if (i == nops - 1) {
+            sqe_flags = 0;
+        } else if (ops[i] == PROXY_SPLICE_IN) {
+            // splice out runs even if a short splice in fails the link
+            sqe_flags = IOSQE_IO_HARDLINK;
+        } else {
+            sqe_flags = IOSQE_IO_LINK;
+        }
+        sqe = Proxy_queue(self, ops[i], sqe_flags);
+        if (sqe == NULL) {
+            if (last != NULL) {
+                // don't link following sqes of others to a broken chain
+                last->flags &= ~(IOSQE_IO_LINK | IOSQE_IO_HARDLINK);
+            }
+            return -1;
+        }
+        last = sqe;
+    }
+    return 0;
+}
+
+// account a completion of current round, queue next round once all of its
+// operations completed. return true if the proxy is finished by this cqe.
+static bool
+Proxy_complete(ProxyObject *self, struct io_uring_cqe *cqe)
+{
+    int op, res = cqe->res;
+
+    for (op = 0; op < PROXY_OPS; op++) {
+        if (self->user_data[op] == cqe->user_data) {
+            break;
+        }
+    }
+    self->pending--;
+    // ECANCELED is caused by a failed poll linked before
+    if (res < 0 && res != -ECANCELED && res != -EAGAIN) {
+        if (self->error == 0) {
+            self->error = res;
+        }
+    } else if (op == PROXY_SPLICE_IN) {
+        if (res > 0) {
+            self->inpipe += res;
+            self->poll_in = false;
+        } else if (res == 0) {
+            self->eof = true;
+        } else if (res == -EAGAIN) {
+            self->poll_in = true;
+        }
+    } else if (op == PROXY_SPLICE_OUT) {
+        if (res > 0) {
+            self->inpipe -= res;
+            self->transferred += res;
+            self->poll_out = false;
+        } else if (res == -EAGAIN && self->inpipe > 0) {
+            self->poll_out = true;
+        }
+    }
+    if (self->pending > 0) {
+        return false;
+    }
+    if (self->error == 0) {
+        switch (Proxy_arm(self)) {
+            case 0:
+                return false;
+            case -1:
+                // we are harvesting, fail the proxy instead of raising
+                self->error = PyErr_ExceptionMatches(PyExc_OSError) && errno ? -errno : -ENOMEM;
+                PyErr_Clear();
+                break;
+        }
+    }
+    Proxy_close_pipe(self);
+    self->done = true;
+    return true;
+}
+
+static PyObject *
+Proxy_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    ProxyObject *self;
+    IoUringObject *ring;
+    int src, dst, pipe_size = 65536;
+
+    if (!Args_check("Proxy", nargs, 3, 4)
+            || !Arg_type(args[0], &IoUringType, "Proxy", 0)
+            || !Arg_int(args[1], &src)
+            || !Arg_int(args[2], &dst)
+            || (nargs > 3 && !Arg_int(args[3], &pipe_size))) {
+        return NULL;
+    }
+    ring = (IoUringObject *) args[0];
+    if (ring->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (pipe_size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "pipe_size must be positive");
+        return NULL;
+    }
+    self = (ProxyObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    Py_INCREF(ring);
+    self->ring = ring;
+    self->src = src;
+    self->dst = dst;
+    self->pipefd[0] = self->pipefd[1] = -1;
+    if (pipe2(self->pipefd, O_CLOEXEC) < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    // kernel rounds the capacity up to pages
+    self->pipe_size = fcntl(self->pipefd[1], F_SETPIPE_SZ, pipe_size);
+    if (self->pipe_size < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    if (Proxy_arm(self) < 0) {
+        goto error;
+    }
+    return (PyObject *) self;
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject *
+Proxy_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("Proxy", kwargs)) {
+        return NULL;
+    }
+    return Proxy_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+Proxy_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("Proxy", kwnames)) {
+        return NULL;
+    }
+    return Proxy_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+static void
+Proxy_dealloc(ProxyObject *self)
+{
+    Proxy_close_pipe(self);
+    Py_XDECREF(self->ring);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// RingGroupObject methods definitions
+
+static PyObject *
+RingGroup_close_rings(RingGroupObject *self)
+{
+    IoUringObject *ring;
+    PyObject *ret;
+
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(self->rings); i++) {
+        ring = (IoUringObject *) PyTuple_GET_ITEM(self->rings, i);
+        if (ring == NULL || ring->slots == NULL) {
+            continue;
+        }
+        ret = IoUring_queue_exit(ring);
+        if (ret == NULL) {
+            return NULL;
+        }
+        Py_DECREF(ret);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+RingGroup_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    RingGroupObject *self;
+    IoUringObject *ring, *first = NULL;
+    struct io_uring_params params;
+    unsigned n, entries, flags = 0;
+    PyObject *ret;
+
+    if (!Args_check("RingGroup", nargs, 2, 3)
+            || !Arg_uint(args[0], &n)
+            || !Arg_uint(args[1], &entries)
+            || (nargs > 2 && !Arg_uint(args[2], &flags))) {
+        return NULL;
+    }
+    if (n == 0) {
+        PyErr_SetString(PyExc_ValueError, "RingGroup needs at least one ring");
+        return NULL;
+    }
+    self = (RingGroupObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->rings = PyTuple_New(n);
+    if (self->rings == NULL) {
+        goto error;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        ring = (IoUringObject *) IoUring_new(&IoUringType, NULL, NULL);
+        if (ring == NULL) {
+            goto error;
+        }
+        PyTuple_SET_ITEM(self->rings, i, (PyObject *) ring);
+        memset(&params, 0, sizeof(params));
+        params.flags = flags;
+        if (first != NULL) {
+            params.flags |= IORING_SETUP_ATTACH_WQ;
+            params.wq_fd = first->ring->ring_fd;
+        } else {
+            first = ring;
+        }
+        ret = IoUring_queue_init_impl(ring, entries, &params);
+        if (ret == NULL) {
+            goto error;
+        }
+        Py_DECREF(ret);
+    }
+    return (PyObject *) self;
+error:
+    if (self->rings != NULL) {
+        PyObject *exc_type, *exc_value, *exc_tb;
+        PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+        Py_XDECREF(RingGroup_close_rings(self));
+        PyErr_Restore(exc_type, exc_value, exc_tb);
+    }
+    Py_DECREF(self);
+    return NULL;
+}
+
+static PyObject *
+RingGroup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("RingGroup", kwargs)) {
+        return NULL;
+    }
+    return RingGroup_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+RingGroup_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("RingGroup", kwnames)) {
+        return NULL;
+    }
+    return RingGroup_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+static void
+RingGroup_dealloc(RingGroupObject *self)
+{
+    // rings may still be used through other references, close() exits them
+    Py_XDECREF(self->rings);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyDoc_STRVAR(
+        ring_group_close_doc,
+        "close() -> None\n\n"
+        "queue_exit every ring of the group that is still initialized.");
+
+static PyObject *
+RingGroup_close(RingGroupObject *self)
+{
+    return RingGroup_close_rings(self);
+}
+
+static Py_ssize_t
+RingGroup_length(RingGroupObject *self)
+{
+    return PyTuple_GET_SIZE(self->rings);
+}
+
+static PyObject *
+RingGroup_item(RingGroupObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= PyTuple_GET_SIZE(self->rings)) {
+        PyErr_SetString(PyExc_IndexError, "RingGroup index out of range");
+        return NULL;
+    }
+    PyObject *ring = PyTuple_GET_ITEM(self->rings, i);
+    Py_INCREF(ring);
+    return ring;
+}
+
+// TimerWheelObject methods definitions
+
+static inline unsigned long long
+TimerWheel_now_tick(TimerWheelObject *self)
+{
+    return (Stats_now() - self->start_ns) / self->resolution_ns;
+}
+
+// put node i in the slot its expiry falls in, relative to the current tick
+static void
+TimerWheel_link(TimerWheelObject *self, unsigned i)
+{
+    TimerNode *node = &self->nodes[i];
+    unsigned long long expires = node->expires, delta;
+    unsigned level = 0, slot;
+
+    if (expires < self->tick) {
+        // overdue, run by the next tick processed
+        expires = self->tick;
+    }
+    delta = expires - self->tick;
+    if (delta >> (TIMER_SLOT_BITS * TIMER_LEVELS)) {
+        // too far for the wheel, parked in the top level and linked again
+        // when it is cascaded
+        delta = (1ULL << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+        expires = self->tick + delta;
+    }
+    while (delta >> (TIMER_SLOT_BITS * (level + 1))) {
+        level++;
+    }
+    slot = (expires >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1);
+    node->list = level * TIMER_SLOTS + slot;
+    node->prev = TIMER_NONE;
+    node->next = self->heads[node->list];
+    if (node->next != TIMER_NONE) {
+        self->nodes[node->next].prev = i;
+    }
+    self->heads[node->list] = i;
+    self->occupied[level] |= 1ULL << slot;
+}
+
+static void
+TimerWheel_unlink(TimerWheelObject *self, unsigned i)
+{
+    TimerNode *node = &self->nodes[i];
+
+    if (node->next != TIMER_NONE) {
+        self->nodes[node->next].prev = node->prev;
+    }
+    if (node->prev != TIMER_NONE) {
+        self->nodes[node->prev].next = node->next;
+    } else {
+        self->heads[node->list] = node->next;
+        if (node->next == TIMER_NONE) {
+            self->occupied[node->list / TIMER_SLOTS] &= ~(1ULL << (node->list % TIMER_SLOTS));
+        }
+    }
+}
+
+// give node i back to the free list, its references are taken by caller
+static void
+TimerWheel_free_node(TimerWheelObject *self, unsigned i)
+{
+    TimerNode *node = &self->nodes[i];
+
+    node->callback = NULL;
+    node->args = NULL;
+    // handles of this node are stale from now on
+    node->generation++;
+    node->next = self->free_node;
+    self->free_node = i;
+    self->count--;
+}
+
+// earliest tick at which a timer is due or a slot has to be cascaded,
+// TIMER_NEVER when the wheel is empty
+static unsigned long long
+TimerWheel_next_tick(TimerWheelObject *self)
+{
+    unsigned long long next = TIMER_NEVER, occupied, at;
+    unsigned shift, start, distance;
+
+    for (unsigned level = 0; level < TIMER_LEVELS; level++) {
+        occupied = self->occupied[level];
+        if (occupied == 0) {
+            continue;
+        }
+        shift = TIMER_SLOT_BITS * level;
+        // slot at the current position has been cascaded already,
+        // unless the current tick is where its span begins
+        distance = (self->tick & ((1ULL << shift) - 1)) ? 1 : 0;
+        start = ((self->tick >> shift) + distance) & (TIMER_SLOTS - 1);
+        if (start) {
+            occupied = (occupied >> start) | (occupied << (TIMER_SLOTS - start));
+        }
+        distance += __builtin_ctzll(occupied);
+        at = ((self->tick >> shift) + distance) << shift;
+        if (at < next) {
+            next = at;
+        }
+    }
+    return next;
+}
+
+// process ticks up to target, cascading higher levels and moving due timers
+// to self->expired. empty ticks are skipped.
+static int
+TimerWheel_advance(TimerWheelObject *self, unsigned long long target)
+{
+    unsigned long long tick;
+    unsigned list, i, next, shift;
+    TimerNode *node;
+    PendingCall *call;
+
+    while (self->count > 0 && (tick = TimerWheel_next_tick(self)) <= target) {
+        self->tick = tick;
+        for (unsigned level = 1; level < TIMER_LEVELS; level++) {
+            shift = TIMER_SLOT_BITS * level;
+            if (tick & ((1ULL << shift) - 1)) {
+                break;
+            }
+            list = level * TIMER_SLOTS + ((tick >> shift) & (TIMER_SLOTS - 1));
+            i = self->heads[list];
+            self->heads[list] = TIMER_NONE;
+            self->occupied[level] &= ~(1ULL << (list % TIMER_SLOTS));
+            for (; i != TIMER_NONE; i = next) {
+                next = self->nodes[i].next;
+                TimerWheel_link(self, i);
+            }
+        }
+        list = tick & (TIMER_SLOTS - 1);
+        while ((i = self->heads[list]) != TIMER_NONE) {
+            if (self->nexpired == self->expired_size) {
+                unsigned size = self->expired_size ? self->expired_size * 2 : CQE_BATCH_STACK;
+                PendingCall *expired = self->expired;
+
+                if (PyMem_Resize(expired, PendingCall, size) == NULL) {
+                    PyErr_NoMemory();
+                    return -1;
+                }
+                self->expired = expired;
+                self->expired_size = size;
+            }
+            node = &self->nodes[i];
+            TimerWheel_unlink(self, i);
+            call = &self->expired[self->nexpired++];
+            call->callback = node->callback;
+            call->args = node->args;
+            call->result = NULL;
+            TimerWheel_free_node(self, i);
+        }
+        self->tick = tick + 1;
+    }
+    if (target >= self->tick) {
+        self->tick = target + 1;
+    }
+    return 0;
+}
+
+// make sure the kernel timeout wakes the ring by the next tick to process.
+// a later timeout is brought forward, an earlier one is left to fire
+// spuriously since cancelling timers must stay free of syscalls.
+static int
+TimerWheel_arm(TimerWheelObject *self)
+{
+    IoUringObject *ring = self->ring;
+    unsigned long long next, ns;
+    unsigned index;
+    SqeObject *sqeobj;
+
+    if (self->count == 0 || ring == NULL || ring->slots == NULL) {
+        return 0;
+    }
+    next = TimerWheel_next_tick(self);
+    if (self->armed && self->armed_tick <= next) {
+        return 0;
+    }
+    ns = self->start_ns + next * self->resolution_ns;
+    self->ts.tv_sec = ns / 1000000000;
+    self->ts.tv_nsec = ns % 1000000000;
+    if (self->armed) {
+        index = (unsigned) self->armed_user_data;
+        sqeobj = index < ring->nslots ? ring->slots[index] : NULL;
+        if (sqeobj != NULL && sqeobj->user_data == self->armed_user_data
+                && sqeobj->sqe != NULL) {
+            // not submitted yet, kernel reads the updated ts
+            self->armed_tick = next;
+            return 0;
+        }
+    }
+    sqeobj = (SqeObject *) IoUring_get_sqe(ring);
+    if (sqeobj == NULL) {
+        // submission queue is full, flush it to make room
+        if (!PyErr_ExceptionMatches(PyExc_OSError) || IoUring_submit_and_wait(ring, 0) < 0) {
+            return -1;
+        }
+        PyErr_Clear();
+        sqeobj = (SqeObject *) IoUring_get_sqe(ring);
+        if (sqeobj == NULL) {
+            return -1;
+        }
+    }
+    if (self->armed) {
+        io_uring_prep_timeout_update(sqeobj->sqe, &self->ts, self->armed_user_data,
+                IORING_TIMEOUT_ABS);
+    } else {
+        io_uring_prep_timeout(sqeobj->sqe, &self->ts, 0, IORING_TIMEOUT_ABS);
+        self->armed = true;
+        self->armed_user_data = sqeobj->user_data;
+    }
+    sqeobj->operation = sqeobj->sqe->opcode;
+    // completions of the wheel are swallowed by harvest
+    Py_INCREF(self);
+    Py_SETREF(sqeobj->data, (PyObject *) self);
+    Py_DECREF(sqeobj);
+    self->armed_tick = next;
+    return 0;
+}
+
+// a cqe of the kernel timeout or its update has been seen
+static void
+TimerWheel_complete(TimerWheelObject *self, SqeObject *sqeobj)
+{
+    if (sqeobj->operation == IORING_OP_TIMEOUT && self->armed
+            && sqeobj->user_data == self->armed_user_data) {
+        self->armed = false;
+    }
+}
+
+// call the timers due by now and arm the kernel timeout for the rest.
+// return number of timers called, or -1 with the first exception raised
+// by them set, the others are written as unraisable.
+static Py_ssize_t
+TimerWheel_expire_due(TimerWheelObject *self)
+{
+    PendingCall *calls;
+    unsigned ncalls, size;
+    PyObject *ret, *exc_type = NULL, *exc_value = NULL, *exc_tb = NULL;
+
+    if (TimerWheel_advance(self, TimerWheel_now_tick(self)) < 0) {
+        return -1;
+    }
+    // timers may expire the wheel again, they get an array of their own
+    calls = self->expired;
+    ncalls = self->nexpired;
+    size = self->expired_size;
+    self->expired = NULL;
+    self->nexpired = self->expired_size = 0;
+    for (unsigned i = 0; i < ncalls; i++) {
+        PyObject *callback = calls[i].callback;
+
+        Py_INCREF(callback);
+        ret = PendingCall_call(&calls[i]);
+        if (ret != NULL) {
+            Py_DECREF(ret);
+        } else if (exc_type == NULL) {
+            PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+        } else {
+            PyErr_WriteUnraisable(callback);
+        }
+        Py_DECREF(callback);
+    }
+    if (self->expired == NULL) {
+        self->expired = calls;
+        self->expired_size = size;
+    } else {
+        PyMem_Free(calls);
+    }
+    if (TimerWheel_arm(self) < 0) {
+        if (exc_type == NULL) {
+            return -1;
+        }
+        PyErr_WriteUnraisable((PyObject *) self);
+    }
+    if (exc_type != NULL) {
+        PyErr_Restore(exc_type, exc_value, exc_tb);
+        return -1;
+    }
+    return ncalls;
+}
+
+// drop all timers and unbind from the ring
+static void
+TimerWheel_clear(TimerWheelObject *self)
+{
+    for (unsigned i = 0; i < self->nnodes; i++) {
+        Py_CLEAR(self->nodes[i].callback);
+        Py_CLEAR(self->nodes[i].args);
+    }
+    PyMem_Free(self->nodes);
+    PyMem_Free(self->expired);
+    self->nodes = NULL;
+    self->expired = NULL;
+    self->nnodes = self->nexpired = self->expired_size = 0;
+    self->free_node = TIMER_NONE;
+    self->count = 0;
+    for (unsigned i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) {
+        self->heads[i] = TIMER_NONE;
+    }
+    memset(self->occupied, 0, sizeof(self->occupied));
+    if (self->ring != NULL) {
+        if (self->ring->timers == self) {
+            self->ring->timers = NULL;
+        }
+        Py_CLEAR(self->ring);
+    }
+}
+
+static PyObject *
+TimerWheel_create(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs)
+{
+    TimerWheelObject *self;
+    IoUringObject *ring;
+    double resolution = 0.001;
+
+    if (!Args_check("TimerWheel", nargs, 1, 2)
+            || !Arg_type(args[0], &IoUringType, "TimerWheel", 0)
+            || (nargs > 1 && !Arg_double(args[1], &resolution))) {
+        return NULL;
+    }
+    if (!(resolution >= 1e-6)) {
+        PyErr_SetString(PyExc_ValueError, "resolution must be at least 1 microsecond");
+        return NULL;
+    }
+    ring = (IoUringObject *) args[0];
+    if (ring->timers != NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring has a TimerWheel already");
+        return NULL;
+    }
+    self = (TimerWheelObject *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    TimerWheel_clear(self);
+    Py_INCREF(ring);
+    self->ring = ring;
+    ring->timers = self;
+    self->resolution_ns = (unsigned long long) (resolution * 1e9);
+    self->start_ns = Stats_now();
+    return (PyObject *) self;
+}
+
+static PyObject *
+TimerWheel_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    if (!Args_no_keywords("TimerWheel", kwargs)) {
+        return NULL;
+    }
+    return TimerWheel_create(type, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+TimerWheel_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    if (!Args_no_keywords("TimerWheel", kwnames)) {
+        return NULL;
+    }
+    return TimerWheel_create((PyTypeObject *) type, args, PyVectorcall_NARGS(nargsf));
+}
+
+static void
+TimerWheel_dealloc(TimerWheelObject *self)
+{
+    TimerWheel_clear(self);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// take a free node, doubling the node array when there is none
+static unsigned
+TimerWheel_acquire_node(TimerWheelObject *self)
+{
+    unsigned i, nnodes;
+    TimerNode *nodes = self->nodes;
+
+    if (self->free_node == TIMER_NONE) {
+        nnodes = self->nnodes ? self->nnodes * 2 : CQE_BATCH_STACK;
+        if (nnodes >= TIMER_NONE || PyMem_Resize(nodes, TimerNode, nnodes) == NULL) {
+            PyErr_NoMemory();
+            return TIMER_NONE;
+        }
+        self->nodes = nodes;
+        // new nodes are chained in index order
+        for (i = nnodes; i-- > self->nnodes;) {
+            nodes[i].callback = nodes[i].args = NULL;
+            nodes[i].generation = 0;
+            nodes[i].next = self->free_node;
+            self->free_node = i;
+        }
+        self->nnodes = nnodes;
+    }
+    i = self->free_node;
+    self->free_node = self->nodes[i].next;
+    self->count++;
+    return i;
+}
+
+PyDoc_STRVAR(
+        timer_wheel_add_doc,
+        "add(delay, callback, *args) -> int\n\n"
+        "call callback(*args) once delay seconds have passed, rounded up to the\n"
+        "resolution. return a handle for cancel.");
+
+static PyObject *
+TimerWheel_add(TimerWheelObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    double delay;
+    PyObject *cbargs = NULL;
+    TimerNode *node;
+    unsigned long long deadline;
+    unsigned i;
+
+    if (!Args_check("add", nargs, 2, PY_SSIZE_T_MAX)
+            || !Arg_double(args[0], &delay)) {
+        return NULL;
+    }
+    if (!PyCallable_Check(args[1])) {
+        PyErr_Format(PyExc_TypeError, "add() argument 2 must be callable, not %.50s",
+                Py_TYPE(args[1])->tp_name);
+        return NULL;
+    }
+    if (self->ring == NULL || self->ring->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring of TimerWheel is not initialized");
+        return NULL;
+    }
+    if (nargs > 2) {
+        cbargs = PyTuple_New(nargs - 2);
+        if (cbargs == NULL) {
+            return NULL;
+        }
+        for (Py_ssize_t j = 2; j < nargs; j++) {
+            Py_INCREF(args[j]);
+            PyTuple_SET_ITEM(cbargs, j - 2, args[j]);
+        }
+    }
+    i = TimerWheel_acquire_node(self);
+    if (i == TIMER_NONE) {
+        Py_XDECREF(cbargs);
+        return NULL;
+    }
+    node = &self->nodes[i];
+    Py_INCREF(args[1]);
+    node->callback = args[1];
+    node->args = cbargs;
+    // never run early, due at the first tick not before the deadline
+    deadline = Stats_now() - self->start_ns;
+    if (delay > 0) {
+        deadline += delay < 1e9 ? (unsigned long long) (delay * 1e9) : 1000000000000000000ULL;
+    }
+    node->expires = (deadline + self->resolution_ns - 1) / self->resolution_ns;
+    TimerWheel_link(self, i);
+    if (TimerWheel_arm(self) < 0) {
+        TimerWheel_unlink(self, i);
+        Py_CLEAR(node->callback);
+        Py_CLEAR(node->args);
+        TimerWheel_free_node(self, i);
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(((unsigned long long) node->generation << 32) | i);
+}
+
+PyDoc_STRVAR(
+        timer_wheel_cancel_doc,
+        "cancel(handle) -> bool\n\n"
+        "cancel the timer handle returned by add, return False when it has been\n"
+        "called or cancelled already.");
+
+static PyObject *
+TimerWheel_cancel(TimerWheelObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    unsigned long long handle;
+    unsigned i;
+    TimerNode *node;
+
+    if (!Args_check("cancel", nargs, 1, 1)) {
+        return NULL;
+    }
+    handle = PyLong_AsUnsignedLongLong(args[0]);
+    if (handle == (unsigned long long) -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    i = (unsigned) handle;
+    if (i >= self->nnodes || self->nodes[i].callback == NULL
+            || self->nodes[i].generation != (unsigned) (handle >> 32)) {
+        Py_RETURN_FALSE;
+    }
+    node = &self->nodes[i];
+    TimerWheel_unlink(self, i);
+    Py_CLEAR(node->callback);
+    Py_CLEAR(node->args);
+    TimerWheel_free_node(self, i);
+    Py_RETURN_TRUE;
+}
+
+PyDoc_STRVAR(
+        timer_wheel_expire_doc,
+        "expire() -> int\n\n"
+        "call the timers which are due and arm the ring timeout for the next one,\n"
+        "return number of timers called. IoUring.run does this by itself, rings\n"
+        "driven by drain or wait_cqe call it when the wheel's timeout fires.");
+
+static PyObject *
+TimerWheel_expire(TimerWheelObject *self)
+{
+    Py_ssize_t n = TimerWheel_expire_due(self);
+
+    if (n < 0) {
+        return NULL;
+    }
+    return PyLong_FromSsize_t(n);
+}
+
+PyDoc_STRVAR(
+        timer_wheel_close_doc,
+        "close() -> None\n\n"
+        "drop all timers, remove the ring timeout and unbind from the ring.");
+
+static PyObject *
+TimerWheel_close(TimerWheelObject *self)
+{
+    SqeObject *sqeobj;
+
+    if (self->armed && self->ring != NULL && self->ring->slots != NULL) {
+        // best effort, otherwise the timeout fires once to no one
+        sqeobj = (SqeObject *) IoUring_get_sqe(self->ring);
+        if (sqeobj == NULL) {
+            PyErr_Clear();
+        } else {
+            io_uring_prep_timeout_remove(sqeobj->sqe, self->armed_user_data, 0);
+            sqeobj->operation = sqeobj->sqe->opcode;
+            Py_INCREF(self);
+            Py_SETREF(sqeobj->data, (PyObject *) self);
+            Py_DECREF(sqeobj);
+        }
+    }
+    self->armed = false;
+    TimerWheel_clear(self);
+    Py_RETURN_NONE;
+}
+
+static Py_ssize_t
+TimerWheel_length(TimerWheelObject *self)
+{
+    return self->count;
+}
+
+// FileStreamObject methods definitions
+
+static PyObject *
+FileStream_new(IoUringObject *ring, PyObject *const *args, Py_ssize_t nargs)
+{
+    FileStreamObject *self;
+    Py_ssize_t chunk_size = 65536;
+    unsigned depth = 4;
+    long long offset = 0, length = -1;
+    int fd;
+
+    if (!Args_check("stream_file", nargs, 1, 5)
+            || !Arg_int(args[0], &fd)
+            || (nargs > 1 && !Arg_ssize(args[1], &chunk_size))
+            || (nargs > 2 && !Arg_uint(args[2], &depth))
+            || (nargs > 3 && !Arg_longlong(args[3], &offset))
+            || (nargs > 4 && !Arg_longlong(args[4], &length))) {
+        return NULL;
+    }
+    if (ring->slots == NULL) {
+        PyErr_SetString(PyExc_ValueError, "IoUring is not initialized");
+        return NULL;
+    }
+    if (chunk_size <= 0 || chunk_size > INT_MAX || depth == 0 || offset < 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid chunk size, depth or offset");
+        return NULL;
+    }
+    if (chunk_size > PY_SSIZE_T_MAX / depth) {
+        return PyErr_NoMemory();
+    }
+    self = PyObject_New(FileStreamObject, &FileStreamType);
+    if (self == NULL) {
+        return NULL;
+    }
+    Py_INCREF(ring);
+    self->ring = ring;
+    self->fd = fd;
+    self->chunk_size = chunk_size;
+    self->depth = depth;
+    self->offset = offset;
+    self->end = length < 0 ? -1 : offset + length;
+    self->head = 0;
+    self->eof = false;
+    self->started = false;
+    self->finished = false;
+    self->handed = false;
+    self->view = NULL;
+    self->export_buf = NULL;
+    self->export_len = 0;
+    self->exports = 0;
+    self->chunks = PyMem_New(FileStreamChunk, depth);
+    // page aligned, so the file may be opened with O_DIRECT
+    self->base = mmap(NULL, chunk_size * depth, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->base == MAP_FAILED) {
+        self->base = NULL;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+    if (self->chunks == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (unsigned i = 0; i < depth; i++) {
+        self->chunks[i].state = CHUNK_IDLE;
+    }
+    return (PyObject *) self;
+error:
+    Py_DECREF(self);
+    return NULL;
+}
+
+// queue a read for the unfilled part of chunk i
+static int
+FileStream_read(FileStreamObject *self, unsigned i)
+{
+    FileStreamChunk *chunk = &self->chunks[i];
+    SqeObject *sqeobj;
+    PyObject *ret;
+
+    if (io_uring_sq_space_left(self->ring->ring) == 0) {
+        ret = IoUring_submit(self->ring);
+        if (ret == NULL) {
+            return -1;
+        }
+        Py_DECREF(ret);
+    }
+    sqeobj = (SqeObject *) IoUring_get_sqe(self->ring);
+    if (sqeobj == NULL) {
+        return -1;
+    }
+    io_uring_prep_read(sqeobj->sqe, self->fd, self->base + i * self->chunk_size + chunk->filled,
+            chunk->len - chunk->filled, chunk->offset + chunk->filled);
+    sqeobj->operation = IORING_OP_READ;
+    Py_INCREF(self);
+    Py_SETREF(sqeobj->data, (PyObject *) self);
+    chunk->user_data = sqeobj->user_data;
+    chunk->state = CHUNK_READING;
+    Py_DECREF(sqeobj);
+    return 0;
+}
+
+// queue chunk i for the next part of file, unless there is nothing left
+static int
+FileStream_queue(FileStreamObject *self, unsigned i)
+{
+    FileStreamChunk *chunk = &self->chunks[i];
+    long long len = self->chunk_size;
+
+    if (self->eof) {
+        return 0;
+    }
+    if (self->end >= 0 && self->end - self->offset < len) {
+        len = self->end - self->offset;
+        if (len == 0) {
+            return 0;
+        }
+    }
+    chunk->offset = self->offset;
+    chunk->len = len;
+    chunk->filled = 0;
+    chunk->error = 0;
+    self->offset += len;
+    return FileStream_read(self, i);
+}
+
+// account a completed read, a short one is continued in the same chunk
+// so that chunks stay contiguous.
+static void
+FileStream_complete(FileStreamObject *self, struct io_uring_cqe *cqe)
+{
+    FileStreamChunk *chunk = NULL;
+    unsigned i;
+
+    for (i = 0; i < self->depth; i++) {
+        if (self->chunks[i].state == CHUNK_READING
+                && self->chunks[i].user_data == cqe->user_data) {
+            chunk = &self->chunks[i];
+            break;
+        }
+    }
+    if (chunk == NULL) {
+        // stale cqe recorded already
+        return;
+    }
+    chunk->state = CHUNK_READY;
+    if (cqe->res < 0) {
+        chunk->error = cqe->res;
+    } else if (cqe->res == 0) {
+        self->eof = true;
+    } else {
+        chunk->filled += cqe->res;
+        if (chunk->filled < chunk->len && FileStream_read(self, i) < 0) {
+            // may be harvesting, fail this chunk instead of raising
+            chunk->state = CHUNK_READY;
+            chunk->error = PyErr_ExceptionMatches(PyExc_OSError) && errno ? -errno : -ENOMEM;
+            PyErr_Clear();
+        }
+    }
+}
+
+// record all completed reads of this stream, and consume those at head of
+// completion queue. the rest are consumed by harvest of who owns the others.
+// return number of cqes left in completion queue.
+static int
+FileStream_collect(FileStreamObject *self)
+{
+    IoUringObject *ring = self->ring;
+    struct io_uring_cqe *stack_cqes[CQE_BATCH_STACK];
+    SqeObject *stack_sqeobjs[CQE_BATCH_STACK];
+    struct io_uring_cqe **cqes = stack_cqes;
+    SqeObject **sqeobjs = stack_sqeobjs;
+    unsigned count, nown = 0;
+
+    count = io_uring_cq_ready(ring->ring);
+    if (count > CQE_BATCH_STACK) {
+        cqes = PyMem_New(struct io_uring_cqe *, count);
+        sqeobjs = PyMem_New(SqeObject *, count);
+        if (cqes == NULL || sqeobjs == NULL) {
+            PyMem_Free(cqes);
+            PyMem_Free(sqeobjs);
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    count = io_uring_peek_batch_cqe(ring->ring, cqes, count);
+    for (unsigned i = 0; i < count; i++) {
+        sqeobjs[i] = IoUring_cqe_sqeobj(ring, cqes[i]);
+        if (sqeobjs[i]->data != (PyObject *) self) {
+            continue;
+        }
+        FileStream_complete(self, cqes[i]);
+        if (nown == i) {
+            nown++;
+        }
+    }
+    if (ring->stats != NULL) {
+        unsigned long long now = Stats_now();
+
+        for (unsigned i = 0; i < nown; i++) {
+            IoUring_stats_complete(ring, sqeobjs[i], cqes[i]->res, cqes[i]->flags, now);
+        }
+    }
+    // slots are released after cq is advanced like harvest does
+    io_uring_cq_advance(ring->ring, nown);
+    for (unsigned i = 0; i < nown; i++) {
+        CqeObject *cqeobj = Sqe_find_cqe(sqeobjs[i], cqes[i]);
+
+        if (cqeobj != NULL) {
+            cqeobj->seen = true;
+            Sqe_unlink_cqe(sqeobjs[i], cqeobj);
+        }
+        IoUring_release_slot(ring, sqeobjs[i]);
+    }
+    if (cqes != stack_cqes) {
+        PyMem_Free(cqes);
+        PyMem_Free(sqeobjs);
+    }
+    return count - nown;
+}
+
+// submit queued reads and wait until chunk i is not being read, or until
+// no chunk is being read if i is depth.
+static int
+FileStream_wait(FileStreamObject *self, unsigned i)
+{
+    IoUringObject *ring = self->ring;
+    struct io_uring_cqe *cqe;
+    PyObject *ret;
+    unsigned j;
+    int left;
+
+    for (;;) {
+        left = FileStream_collect(self);
+        if (left < 0) {
+            return -1;
+        }
+        if (i < self->depth) {
+            if (self->chunks[i].state != CHUNK_READING) {
+                return 0;
+            }
+        } else {
+            for (j = 0; j < self->depth; j++) {
+                if (self->chunks[j].state == CHUNK_READING) {
+                    break;
+                }
+            }
+            if (j == self->depth) {
+                return 0;
+            }
+        }
+        // a short read may have been continued
+        if (io_uring_sq_ready(ring->ring)) {
+            ret = IoUring_submit(ring);
+            if (ret == NULL) {
+                return -1;
+            }
+            Py_DECREF(ret);
+            continue;
+        }
+        if ((unsigned) left == ring->ring->cq.ring_entries) {
+            // our cqe can't be posted until others at head are consumed
+            errno = EBUSY;
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        // wait for one more than what was collected, those arrived
+        // meanwhile are counted as well.
+        if (IoUring_wait_cqe_nogil(ring, &cqe, left + 1, NULL)) {
+            return -1;
+        }
+    }
 }
 
-PyDoc_STRVAR(
-        prep_timeout_remove_doc,
-        "prep_timeout_remove(sqe[, flags]) -> None\n\n"
-        "prepare an attempt to remove an existing timeout operation.");
-
+// stop queuing, wait for reads in flight to keep buffers untouched by kernel
 static PyObject *
-Sqe_prep_timeout_remove(SqeObject *self, PyObject *args)
+FileStream_finish(FileStreamObject *self)
 {
-    // TODO: impl
-    SqeObject *timeout;
-    unsigned flags = 0;
+    PyObject *exc_type, *exc_value, *exc_tb;
 
-    if (!PyArg_ParseTuple(args, "O!I|prep_timeout_remove", &timeout, &flags)) {
-        return NULL;
+    self->finished = true;
+    self->eof = true;
+    PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+    if (FileStream_wait(self, self->depth) < 0) {
+        // the original error is more interesting
+        if (exc_type != NULL) {
+            PyErr_Clear();
+        } else {
+            return NULL;
+        }
     }
-    io_uring_prep_timeout_remove(self->sqe, (__u64) timeout, flags);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    PyErr_Restore(exc_type, exc_value, exc_tb);
+    return NULL;
 }
 
-PyDoc_STRVAR(
-        prep_cancel_doc,
-        "prep_cancel(sqe) -> None\n\n"
-        "prep an operation to cancel submitted operation.");
-
-static PyObject *
-Sqe_prep_cancel(SqeObject *self, PyObject *args)
+// chunk is only valid until next one is requested, make sure nobody can
+// see its buffer before it is queued again.
+static int
+FileStream_release_view(FileStreamObject *self)
 {
-    // TODO: impl
-    SqeObject *cancel;
-    unsigned flags = 0;
+    PyObject *ret;
 
-    if (!PyArg_ParseTuple(args, "O!I:prep_cancel", &SqeType, &cancel, &flags)) {
-        return NULL;
+    if (self->view != NULL) {
+        ret = PyObject_CallMethod(self->view, "release", NULL);
+        if (ret == NULL) {
+            return -1;
+        }
+        Py_DECREF(ret);
+        Py_CLEAR(self->view);
     }
-    io_uring_prep_cancel(self->sqe, cancel, flags);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "views of last chunk are still alive");
+        return -1;
+    }
+    return 0;
 }
 
-PyDoc_STRVAR(
-        prep_close_doc,
-        "prep_close(fd) -> None\n\n"
-        "prepare an operation to close fd.");
-
 static PyObject *
-Sqe_prep_close(SqeObject *self, PyObject *args)
+FileStream_iternext(FileStreamObject *self)
 {
-    int fd;
-    if (!PyArg_ParseTuple(args, "i:prep_close", &fd)) {
+    FileStreamChunk *chunk;
+    PyObject *view, *ret;
+    unsigned prev = (self->head + self->depth - 1) % self->depth;
+
+    if (FileStream_release_view(self) < 0) {
         return NULL;
     }
-    io_uring_prep_close(self->sqe, fd);
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
-}
-
-PyDoc_STRVAR(
-        prep_openat_doc,
-        "prep_openat() -> None\n\n"
-        "Issue the equivalent of a openat(2) system call");
-
-static PyObject *
-Sqe_prep_openat(SqeObject *self, PyObject *args)
-{
-    self->operation = self->sqe->opcode;
-    Py_RETURN_NONE;
+    if (self->finished) {
+        return NULL;
+    }
+    if (self->handed) {
+        self->handed = false;
+        if (FileStream_queue(self, prev) < 0) {
+            return FileStream_finish(self);
+        }
+        // keep depth reads in flight while user processes this chunk
+        if (io_uring_sq_ready(self->ring->ring)) {
+            ret = IoUring_submit(self->ring);
+            if (ret == NULL) {
+                return FileStream_finish(self);
+            }
+            Py_DECREF(ret);
+        }
+    } else if (!self->started) {
+        self->started = true;
+        for (unsigned i = 0; i < self->depth; i++) {
+            if (FileStream_queue(self, i) < 0) {
+                return FileStream_finish(self);
+            }
+        }
+    }
+    chunk = &self->chunks[self->head];
+    if (chunk->state == CHUNK_READING && FileStream_wait(self, self->head) < 0) {
+        return FileStream_finish(self);
+    }
+    if (chunk->error) {
+        chunk->state = CHUNK_IDLE;
+        errno = -chunk->error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return FileStream_finish(self);
+    }
+    if (chunk->state == CHUNK_IDLE || chunk->filled == 0) {
+        chunk->state = CHUNK_IDLE;
+        return FileStream_finish(self);
+    }
+    self->export_buf = self->base + self->head * self->chunk_size;
+    self->export_len = chunk->filled;
+    view = PyMemoryView_FromObject((PyObject *) self);
+    self->export_buf = NULL;
+    if (view == NULL) {
+        return FileStream_finish(self);
+    }
+    chunk->state = CHUNK_IDLE;
+    self->head = (self->head + 1) % self->depth;
+    self->handed = true;
+    Py_INCREF(view);
+    self->view = view;
+    return view;
 }
 
 PyDoc_STRVAR(
-        set_data_doc,
-        "set_data(data) -> None\n\n"
-        "set the data related to this sqe, can be reached by related cqe.");
+        file_stream_close_doc,
+        "close() -> None\n\n"
+        "stop streaming, wait for reads in flight and release the last chunk.");
 
 static PyObject *
-Sqe_set_data(SqeObject *self, PyObject *args)
+FileStream_close(FileStreamObject *self)
 {
-    PyObject *data;
-    if (!PyArg_ParseTuple(args, "O:set_data", &data)) {
+    if (FileStream_release_view(self) < 0) {
+        return NULL;
+    }
+    if (!self->finished && FileStream_finish(self) == NULL && PyErr_Occurred()) {
         return NULL;
     }
-    Py_INCREF(data);
-    Py_DECREF(self->data);
-    self->data = data;
     Py_RETURN_NONE;
 }
 
-// CqeObject methods definitions
-static PyObject *
-Cqe_new(PyTypeObject *type, PyObject *args, PyObject *kwlist)
+static int
+FileStream_getbuffer(FileStreamObject *self, Py_buffer *view, int flags)
 {
-    CqeObject *self;
-    self = (CqeObject *) (type->tp_alloc(type, 0));
-    if (self != NULL) {
-        self->seen = false;
-    } else {
-        return NULL;
+    if (self->export_buf == NULL) {
+        PyErr_SetString(PyExc_BufferError, "iterate FileStream to get its chunks");
+        return -1;
     }
-    return (PyObject*) self;
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->export_buf, self->export_len, 1, flags) < 0) {
+        return -1;
+    }
+    self->exports++;
+    return 0;
 }
 
 static void
-Cqe_dealloc(CqeObject *self)
-{
-    // when user keep an reference to related sqeobj
-    // the specified sqeobj won't be gc, and also this
-    // cqe may not call cqe_seen method, so we reset sqeobj's
-    // cqeobj field, to allow new one can be created by
-    // wait cqe or peek cqe method without segmentfault
-    // caused by sqeobj's invalid cqeobj pointer
-    self->sqeobj->cqeobj = NULL;
-    Py_XDECREF((PyObject *) self->sqeobj);
-    Py_TYPE(self)->tp_free((PyObject *) self);
-}
-
-PyDoc_STRVAR(
-        get_data_doc,
-        "get_data() -> any\n\n"
-        "get data set in related sqe.");
-
-static PyObject *
-Cqe_get_data(CqeObject *self, PyObject *args)
-{
-    PyObject *data = (PyObject *) self->sqeobj->data;
-    Py_INCREF(data);
-    return data;
-}
-
-PyDoc_STRVAR(
-        res_doc,
-        "res() -> int\n\n"
-        "operation res.");
-
-static PyObject *
-Cqe_res(CqeObject *self, PyObject *args)
+FileStream_releasebuffer(FileStreamObject *self, Py_buffer *view)
 {
-    return PyLong_FromLong(self->cqe->res);
+    self->exports--;
 }
 
-static PyObject *
-Cqe_getresult(CqeObject *self)
+static void
+FileStream_dealloc(FileStreamObject *self)
 {
-    SqeObject *sqeobj = self->sqeobj;
-    // struct io_uring_cqe *cqe = self->cqe;
-    int operation = sqeobj->operation;
-    int res = self->cqe->res;
-    if (res < 0) {
-        errno = -res;
-        return PyErr_SetFromErrno(PyExc_OSError);
-    }
-    switch (operation) {
-        case IORING_OP_NOP:
-            Py_RETURN_NONE;
-        case IORING_OP_READ:
-        case IORING_OP_RECV:
-            if (res != PyBytes_GET_SIZE(sqeobj->allocated_buffer)
-                    && _PyBytes_Resize(&(sqeobj->allocated_buffer), res)) {
-                return NULL;
-            }
-            Py_INCREF(sqeobj->allocated_buffer);
-            return sqeobj->allocated_buffer;
-        default:
-            return PyLong_FromLong(res);
+    // reads in flight hold a reference, nothing is in kernel now
+    Py_XDECREF(self->view);
+    if (self->base != NULL) {
+        munmap(self->base, self->chunk_size * self->depth);
     }
+    PyMem_Free(self->chunks);
+    Py_XDECREF(self->ring);
+    PyObject_Del(self);
 }
 
 // IoUringType definition
 
 static PyMethodDef IoUring_methods[] = {
     {"get_sqe", (PyCFunction) IoUring_get_sqe, METH_NOARGS, get_sqe_doc},
-    {"queue_init", (PyCFunction) IoUring_queue_init, METH_VARARGS, queue_init_doc},
+    {"queue_init", (PyCFunction) IoUring_queue_init, METH_FASTCALL, queue_init_doc},
+    {"queue_init_params", (PyCFunction) IoUring_queue_init_params, METH_VARARGS | METH_KEYWORDS, queue_init_params_doc},
+    {"features", (PyCFunction) IoUring_features, METH_NOARGS, features_doc},
     {"queue_exit", (PyCFunction) IoUring_queue_exit, METH_NOARGS, queue_exit_doc},
     {"submit", (PyCFunction) IoUring_submit, METH_NOARGS, submit_doc},
-    {"wait_cqe_nr", (PyCFunction) IoUring_wait_cqe_nr, METH_VARARGS, wait_cqe_nr_doc},
-    {"wait_cqes", (PyCFunction) IoUring_wait_cqes, METH_VARARGS, wait_cqe_nr_doc},
+    {"wait_cqe_nr", (PyCFunction) IoUring_wait_cqe_nr, METH_FASTCALL, wait_cqe_nr_doc},
+    {"wait_cqes", (PyCFunction) IoUring_wait_cqes, METH_FASTCALL, wait_cqe_nr_doc},
     {"wait_cqe", (PyCFunction) IoUring_wait_cqe, METH_NOARGS, wait_cqe_doc},
     {"peek_cqe", (PyCFunction) IoUring_peek_cqe, METH_NOARGS, peek_cqe_doc},
-    {"cqe_seen", (PyCFunction) IoUring_cqe_seen, METH_VARARGS, cqe_seen_doc},
+    {"cqe_seen", (PyCFunction) IoUring_cqe_seen, METH_FASTCALL, cqe_seen_doc},
+    {"peek_batch", (PyCFunction) IoUring_peek_batch, METH_FASTCALL, peek_batch_doc},
+    {"drain", (PyCFunction) IoUring_drain, METH_FASTCALL, drain_doc},
+    {"run", (PyCFunction) IoUring_run, METH_FASTCALL, run_doc},
     {"sq_ready", (PyCFunction) IoUring_sq_ready, METH_NOARGS, sq_ready_doc},
     {"sq_space_left", (PyCFunction) IoUring_sq_space_left, METH_NOARGS, sq_space_left_doc},
     {"cq_ready", (PyCFunction) IoUring_cq_ready, METH_NOARGS, cq_ready_doc},
+    {"enable_stats", (PyCFunction) IoUring_enable_stats, METH_FASTCALL, enable_stats_doc},
+    {"stats", (PyCFunction) IoUring_stats, METH_NOARGS, stats_doc},
     {"cq_event_fd_enabled", (PyCFunction) IoUring_cq_event_fd_enabled, METH_NOARGS, ""},
+    {"register_files", (PyCFunction) IoUring_register_files, METH_FASTCALL, register_files_doc},
+    {"register_files_update", (PyCFunction) IoUring_register_files_update, METH_FASTCALL, register_files_update_doc},
+    {"unregister_files", (PyCFunction) IoUring_unregister_files, METH_NOARGS, unregister_files_doc},
+    {"register_eventfd", (PyCFunction) IoUring_register_eventfd, METH_FASTCALL, register_eventfd_doc},
+    {"register_eventfd_async", (PyCFunction) IoUring_register_eventfd_async, METH_FASTCALL, register_eventfd_async_doc},
+    {"unregister_eventfd", (PyCFunction) IoUring_unregister_eventfd, METH_NOARGS, unregister_eventfd_doc},
+    {"fileno", (PyCFunction) IoUring_fileno, METH_NOARGS, fileno_doc},
+    {"stream_file", (PyCFunction) IoUring_stream_file, METH_FASTCALL, stream_file_doc},
+    {"submit_ops", (PyCFunction) IoUring_submit_ops, METH_FASTCALL, submit_ops_doc},
     {NULL}
 };
 
@@ -865,20 +5942,44 @@ static PyTypeObject IoUringType = {
 // SqeType definition
 
 static PyMethodDef Sqe_methods[] = {
-    {"prep_recv", (PyCFunction) Sqe_prep_recv, METH_VARARGS, prep_recv_doc},
-    {"prep_send", (PyCFunction) Sqe_prep_send, METH_VARARGS, prep_send_doc},
-    {"prep_connect", (PyCFunction) Sqe_prep_connect, METH_VARARGS, prep_connect_doc},
-    {"prep_accept", (PyCFunction) Sqe_prep_accept, METH_VARARGS, prep_accept_doc},
-    {"prep_read", (PyCFunction) Sqe_prep_read, METH_VARARGS, prep_read_doc},
-    {"prep_write", (PyCFunction) Sqe_prep_write, METH_VARARGS, prep_write_doc},
-    {"set_data", (PyCFunction) Sqe_set_data, METH_VARARGS, set_data_doc},
-    {"convert_address", (PyCFunction) Sqe_convert_address, METH_NOARGS, ""},
+    {"prep_recv", (PyCFunction) Sqe_prep_recv, METH_FASTCALL, prep_recv_doc},
+    {"prep_send", (PyCFunction) Sqe_prep_send, METH_FASTCALL, prep_send_doc},
+    {"prep_recv_into", (PyCFunction) Sqe_prep_recv_into, METH_FASTCALL, prep_recv_into_doc},
+    {"prep_recv_select", (PyCFunction) Sqe_prep_recv_select, METH_FASTCALL, prep_recv_select_doc},
+    {"prep_recv_multishot", (PyCFunction) Sqe_prep_recv_multishot, METH_FASTCALL, prep_recv_multishot_doc},
+    {"prep_connect", (PyCFunction) Sqe_prep_connect, METH_FASTCALL, prep_connect_doc},
+    {"prep_accept", (PyCFunction) Sqe_prep_accept, METH_FASTCALL, prep_accept_doc},
+    {"prep_accept_direct", (PyCFunction) Sqe_prep_accept_direct, METH_FASTCALL, prep_accept_direct_doc},
+    {"prep_multishot_accept", (PyCFunction) Sqe_prep_multishot_accept, METH_FASTCALL, prep_multishot_accept_doc},
+    {"prep_read", (PyCFunction) Sqe_prep_read, METH_FASTCALL, prep_read_doc},
+    {"prep_read_into", (PyCFunction) Sqe_prep_read_into, METH_FASTCALL, prep_read_into_doc},
+    {"prep_write", (PyCFunction) Sqe_prep_write, METH_FASTCALL, prep_write_doc},
+    {"prep_readv", (PyCFunction) Sqe_prep_readv, METH_FASTCALL, prep_readv_doc},
+    {"prep_writev", (PyCFunction) Sqe_prep_writev, METH_FASTCALL, prep_writev_doc},
+    {"prep_read_fixed", (PyCFunction) Sqe_prep_read_fixed, METH_FASTCALL, prep_read_fixed_doc},
+    {"prep_write_fixed", (PyCFunction) Sqe_prep_write_fixed, METH_FASTCALL, prep_write_fixed_doc},
+    {"set_data", (PyCFunction) Sqe_set_data, METH_FASTCALL, set_data_doc},
+    {"set_callback", (PyCFunction) Sqe_set_callback, METH_FASTCALL, set_callback_doc},
+    {"set_fixed_file", (PyCFunction) Sqe_set_fixed_file, METH_NOARGS, set_fixed_file_doc},
+    {"set_flags", (PyCFunction) Sqe_set_flags, METH_FASTCALL, set_flags_doc},
+    {"convert_address", (PyCFunction) Sqe_convert_address, METH_NOARGS, convert_address_doc},
     {"prep_nop", (PyCFunction) Sqe_prep_nop, METH_NOARGS, prep_nop_doc},
-    {"prep_timeout", (PyCFunction) Sqe_prep_timeout, METH_VARARGS, prep_timeout_doc},
-    {"prep_timeout_remove", (PyCFunction) Sqe_prep_timeout_remove, METH_VARARGS, prep_timeout_remove_doc},
-    {"prep_close", (PyCFunction) Sqe_prep_close, METH_VARARGS, prep_close_doc},
-    {"prep_openat", (PyCFunction) Sqe_prep_openat, METH_VARARGS, prep_openat_doc},
-    {"prep_cancel", (PyCFunction) Sqe_prep_cancel, METH_VARARGS, prep_cancel_doc},
+    {"prep_timeout", (PyCFunction) Sqe_prep_timeout, METH_FASTCALL, prep_timeout_doc},
+    {"prep_timeout_remove", (PyCFunction) Sqe_prep_timeout_remove, METH_FASTCALL, prep_timeout_remove_doc},
+    {"prep_link_timeout", (PyCFunction) Sqe_prep_link_timeout, METH_FASTCALL, prep_link_timeout_doc},
+    {"prep_close", (PyCFunction) Sqe_prep_close, METH_FASTCALL, prep_close_doc},
+    {"prep_close_direct", (PyCFunction) Sqe_prep_close_direct, METH_FASTCALL, prep_close_direct_doc},
+    {"prep_send_msg", (PyCFunction) Sqe_prep_send_msg, METH_FASTCALL, prep_send_msg_doc},
+    {"prep_splice", (PyCFunction) Sqe_prep_splice, METH_FASTCALL, prep_splice_doc},
+    {"prep_tee", (PyCFunction) Sqe_prep_tee, METH_FASTCALL, prep_tee_doc},
+    {"prep_openat", (PyCFunction) Sqe_prep_openat, METH_FASTCALL, prep_openat_doc},
+    {"prep_statx", (PyCFunction) Sqe_prep_statx, METH_FASTCALL, prep_statx_doc},
+    {"prep_fsync", (PyCFunction) Sqe_prep_fsync, METH_FASTCALL, prep_fsync_doc},
+    {"prep_sync_file_range", (PyCFunction) Sqe_prep_sync_file_range, METH_FASTCALL, prep_sync_file_range_doc},
+    {"prep_fallocate", (PyCFunction) Sqe_prep_fallocate, METH_FASTCALL, prep_fallocate_doc},
+    {"prep_unlinkat", (PyCFunction) Sqe_prep_unlinkat, METH_FASTCALL, prep_unlinkat_doc},
+    {"prep_renameat", (PyCFunction) Sqe_prep_renameat, METH_FASTCALL, prep_renameat_doc},
+    {"prep_cancel", (PyCFunction) Sqe_prep_cancel, METH_FASTCALL, prep_cancel_doc},
     {NULL}
 };
 
@@ -915,14 +6016,406 @@ static PyTypeObject CqeType = {
     .tp_methods = Cqe_methods
 };
 
+// BufferPoolType definition
+
+static PyMethodDef BufferPool_methods[] = {
+    {"buffer", (PyCFunction) BufferPool_buffer, METH_FASTCALL, buffer_pool_buffer_doc},
+    {"close", (PyCFunction) BufferPool_close, METH_NOARGS, buffer_pool_close_doc},
+    {NULL}
+};
+
+static PyMemberDef BufferPool_members[] = {
+    {"size", T_PYSSIZET, offsetof(BufferPoolObject, size), READONLY, "size of each buffer"},
+    {NULL}
+};
+
+static PySequenceMethods BufferPool_as_sequence = {
+    .sq_length = (lenfunc) BufferPool_length,
+};
+
+static PyBufferProcs BufferPool_as_buffer = {
+    .bf_getbuffer = (getbufferproc) BufferPool_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) BufferPool_releasebuffer,
+};
+
+static PyTypeObject BufferPoolType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.BufferPool",
+    .tp_doc = "BufferPool(ring, nbufs, size)\n\n"
+        "page aligned buffers registered to ring for prep_read_fixed and prep_write_fixed.",
+    .tp_basicsize = sizeof(BufferPoolObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = BufferPool_new,
+    .tp_vectorcall = BufferPool_vectorcall,
+    .tp_dealloc = (destructor) BufferPool_dealloc,
+    .tp_methods = BufferPool_methods,
+    .tp_members = BufferPool_members,
+    .tp_as_sequence = &BufferPool_as_sequence,
+    .tp_as_buffer = &BufferPool_as_buffer,
+};
+
+// BufferRingType definition
+
+static PyMethodDef BufferRing_methods[] = {
+    {"close", (PyCFunction) BufferRing_close, METH_NOARGS, buffer_ring_close_doc},
+    {NULL}
+};
+
+static PyMemberDef BufferRing_members[] = {
+    {"bgid", T_INT, offsetof(BufferRingObject, bgid), READONLY, "buffer group id"},
+    {"size", T_PYSSIZET, offsetof(BufferRingObject, size), READONLY, "size of each buffer"},
+    {NULL}
+};
+
+static PyTypeObject BufferRingType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.BufferRing",
+    .tp_doc = "BufferRing(ring, bgid, nbufs, size)\n\n"
+        "group of buffers provided to kernel, selected by prep_recv_select when data arrives.",
+    .tp_basicsize = sizeof(BufferRingObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = BufferRing_new,
+    .tp_vectorcall = BufferRing_vectorcall,
+    .tp_dealloc = (destructor) BufferRing_dealloc,
+    .tp_methods = BufferRing_methods,
+    .tp_members = BufferRing_members,
+};
+
+// ProvidedBufferType definition
+
+static PyMethodDef ProvidedBuffer_methods[] = {
+    {"release", (PyCFunction) ProvidedBuffer_release, METH_NOARGS, provided_buffer_release_doc},
+    {"__bytes__", (PyCFunction) ProvidedBuffer_bytes, METH_NOARGS, ""},
+    {NULL}
+};
+
+static PyMemberDef ProvidedBuffer_members[] = {
+    {"bid", T_USHORT, offsetof(ProvidedBufferObject, bid), READONLY, "buffer id in BufferRing"},
+    {NULL}
+};
+
+static PySequenceMethods ProvidedBuffer_as_sequence = {
+    .sq_length = (lenfunc) ProvidedBuffer_length,
+};
+
+static PyBufferProcs ProvidedBuffer_as_buffer = {
+    .bf_getbuffer = (getbufferproc) ProvidedBuffer_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) ProvidedBuffer_releasebuffer,
+};
+
+static PyTypeObject ProvidedBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.ProvidedBuffer",
+    .tp_doc = "ProvidedBuffer Object",
+    .tp_basicsize = sizeof(ProvidedBufferObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) ProvidedBuffer_dealloc,
+    .tp_methods = ProvidedBuffer_methods,
+    .tp_members = ProvidedBuffer_members,
+    .tp_as_sequence = &ProvidedBuffer_as_sequence,
+    .tp_as_buffer = &ProvidedBuffer_as_buffer,
+};
+
+// AlignedBufferType definition
+
+static PyMemberDef AlignedBuffer_members[] = {
+    {"alignment", T_PYSSIZET, offsetof(AlignedBufferObject, alignment), READONLY,
+        "unit of address, length and offset of direct I/O"},
+    {NULL}
+};
+
+static PySequenceMethods AlignedBuffer_as_sequence = {
+    .sq_length = (lenfunc) AlignedBuffer_length,
+};
+
+static PyBufferProcs AlignedBuffer_as_buffer = {
+    .bf_getbuffer = (getbufferproc) AlignedBuffer_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) AlignedBuffer_releasebuffer,
+};
+
+static PyTypeObject AlignedBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.AlignedBuffer",
+    .tp_doc = "AlignedBuffer(size[, alignment])\n\n"
+        "zero filled, page aligned buffer for O_DIRECT I/O. size is rounded up to a\n"
+        "multiple of alignment, page size by default, see dio_alignment().\n"
+        "read and write operations on it, or on a memoryview slice of it, check\n"
+        "that address, length and offset are multiples of alignment.",
+    .tp_basicsize = sizeof(AlignedBufferObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = AlignedBuffer_new,
+    .tp_vectorcall = AlignedBuffer_vectorcall,
+    .tp_dealloc = (destructor) AlignedBuffer_dealloc,
+    .tp_members = AlignedBuffer_members,
+    .tp_as_sequence = &AlignedBuffer_as_sequence,
+    .tp_as_buffer = &AlignedBuffer_as_buffer,
+};
+
+// ProxyType definition
+
+static PyMemberDef Proxy_members[] = {
+    {"src", T_INT, offsetof(ProxyObject, src), READONLY, "fd data is read from"},
+    {"dst", T_INT, offsetof(ProxyObject, dst), READONLY, "fd data is written to"},
+    {"pipe_size", T_INT, offsetof(ProxyObject, pipe_size), READONLY, "capacity of the pipe"},
+    {"transferred", T_LONGLONG, offsetof(ProxyObject, transferred), READONLY,
+        "number of bytes written to dst"},
+    {"done", T_BOOL, offsetof(ProxyObject, done), READONLY, "whether the transfer is finished"},
+    {NULL}
+};
+
+static PyTypeObject ProxyType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.Proxy",
+    .tp_doc = "Proxy(ring, src, dst[, pipe_size])\n\n"
+        "splice data from src to dst through a pipe until end of src or an error,\n"
+        "without copying it to user space. operations are queued on ring, submit()\n"
+        "them and keep calling peek_batch() or drain(), which return\n"
+        "(proxy, transferred bytes or negative errno, 0) once when it is done.\n"
+        "shutdown src or dst to stop it early.",
+    .tp_basicsize = sizeof(ProxyObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Proxy_new,
+    .tp_vectorcall = Proxy_vectorcall,
+    .tp_dealloc = (destructor) Proxy_dealloc,
+    .tp_members = Proxy_members,
+};
+
+// RingGroupType definition
+
+static PyMethodDef RingGroup_methods[] = {
+    {"close", (PyCFunction) RingGroup_close, METH_NOARGS, ring_group_close_doc},
+    {NULL}
+};
+
+static PySequenceMethods RingGroup_as_sequence = {
+    .sq_length = (lenfunc) RingGroup_length,
+    .sq_item = (ssizeargfunc) RingGroup_item,
+};
+
+static PyTypeObject RingGroupType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.RingGroup",
+    .tp_doc = "RingGroup(n, entries[, flags])\n\n"
+        "n initialized rings of entries, the rings after the first are set up with\n"
+        "IORING_SETUP_ATTACH_WQ so all of them share one kernel io-wq worker pool.\n"
+        "meant for one ring per thread, rings hand work to each other by\n"
+        "Sqe.prep_send_msg. indexing gives the rings.",
+    .tp_basicsize = sizeof(RingGroupObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = RingGroup_new,
+    .tp_vectorcall = RingGroup_vectorcall,
+    .tp_dealloc = (destructor) RingGroup_dealloc,
+    .tp_methods = RingGroup_methods,
+    .tp_as_sequence = &RingGroup_as_sequence,
+};
+
+// TimerWheelType definition
+
+static PyMethodDef TimerWheel_methods[] = {
+    {"add", (PyCFunction) TimerWheel_add, METH_FASTCALL, timer_wheel_add_doc},
+    {"cancel", (PyCFunction) TimerWheel_cancel, METH_FASTCALL, timer_wheel_cancel_doc},
+    {"expire", (PyCFunction) TimerWheel_expire, METH_NOARGS, timer_wheel_expire_doc},
+    {"close", (PyCFunction) TimerWheel_close, METH_NOARGS, timer_wheel_close_doc},
+    {NULL}
+};
+
+static PySequenceMethods TimerWheel_as_sequence = {
+    .sq_length = (lenfunc) TimerWheel_length,
+};
+
+static PyTypeObject TimerWheelType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.TimerWheel",
+    .tp_doc = "TimerWheel(ring[, resolution])\n\n"
+        "timers of ring kept in a hierarchical timing wheel of resolution seconds,\n"
+        "0.001 by default. adding and cancelling a timer is O(1) and needs no sqe,\n"
+        "a single kernel timeout is armed for the next expiry and due timers are\n"
+        "called by IoUring.run. a ring has one TimerWheel at most. len() gives\n"
+        "number of pending timers.",
+    .tp_basicsize = sizeof(TimerWheelObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = TimerWheel_new,
+    .tp_vectorcall = TimerWheel_vectorcall,
+    .tp_dealloc = (destructor) TimerWheel_dealloc,
+    .tp_methods = TimerWheel_methods,
+    .tp_as_sequence = &TimerWheel_as_sequence,
+};
+
+// FileStreamType definition
+
+static PyMethodDef FileStream_methods[] = {
+    {"close", (PyCFunction) FileStream_close, METH_NOARGS, file_stream_close_doc},
+    {NULL}
+};
+
+static PyMemberDef FileStream_members[] = {
+    {"fd", T_INT, offsetof(FileStreamObject, fd), READONLY, "fd being read"},
+    {"chunk_size", T_PYSSIZET, offsetof(FileStreamObject, chunk_size), READONLY, "size of each chunk"},
+    {"depth", T_UINT, offsetof(FileStreamObject, depth), READONLY, "number of reads in flight"},
+    {NULL}
+};
+
+static PyBufferProcs FileStream_as_buffer = {
+    .bf_getbuffer = (getbufferproc) FileStream_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) FileStream_releasebuffer,
+};
+
+static PyTypeObject FileStreamType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "py_io_uring.FileStream",
+    .tp_doc = "FileStream Object\n\n"
+        "iterator of read only memoryviews of file chunks in order, created by\n"
+        "IoUring.stream_file(). a chunk is released and its buffer reused when next\n"
+        "chunk is requested, copy it with bytes() to keep the data. other completions\n"
+        "on the ring must be drained for the stream to go on.\n"
+        "a read error is raised in place of the chunk which failed.",
+    .tp_basicsize = sizeof(FileStreamObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) FileStream_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) FileStream_iternext,
+    .tp_methods = FileStream_methods,
+    .tp_members = FileStream_members,
+    .tp_as_buffer = &FileStream_as_buffer,
+};
+
+// StatxResultType definition
+
+static PyStructSequence_Field statx_result_fields[] = {
+    {"mask", "mask of fields filled by kernel, STATX_*"},
+    {"blksize", "block size for filesystem I/O"},
+    {"attributes", "STATX_ATTR_* flags"},
+    {"nlink", "number of hard links"},
+    {"uid", "user ID of owner"},
+    {"gid", "group ID of owner"},
+    {"mode", "file type and mode"},
+    {"ino", "inode number"},
+    {"size", "total size in bytes"},
+    {"blocks", "number of 512B blocks allocated"},
+    {"attributes_mask", "attributes supported by the filesystem"},
+    {"atime_ns", "time of last access in nanoseconds"},
+    {"btime_ns", "time of creation in nanoseconds"},
+    {"ctime_ns", "time of last status change in nanoseconds"},
+    {"mtime_ns", "time of last modification in nanoseconds"},
+    {"rdev_major", "major ID of device file"},
+    {"rdev_minor", "minor ID of device file"},
+    {"dev_major", "major ID of device containing file"},
+    {"dev_minor", "minor ID of device containing file"},
+    {NULL}
+};
+
+static PyStructSequence_Desc statx_result_desc = {
+    .name = "py_io_uring.StatxResult",
+    .doc = "result of prep_statx operation, see statx(2).",
+    .fields = statx_result_fields,
+    .n_in_sequence = 19,
+};
+
+static PyMethodDef PyIoUring_methods[] = {
+    {"dio_alignment", (PyCFunction) PyIoUring_dio_alignment, METH_FASTCALL, dio_alignment_doc},
+    {NULL}
+};
+
 static PyModuleDef PyIoUringModule = {
     PyModuleDef_HEAD_INIT,
     .m_name = "py_io_uring",
     .m_doc = "Python wrapper for linux async interface io_uring",
-    .m_size = -1
+    .m_size = -1,
+    .m_methods = PyIoUring_methods,
 };
 
 
+static int
+add_constants(PyObject *m)
+{
+    if (
+            PyModule_AddIntMacro(m, IORING_SETUP_IOPOLL) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_SQPOLL) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_SQ_AFF) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_CQSIZE) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_CLAMP) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_ATTACH_WQ) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_R_DISABLED) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_SUBMIT_ALL) < 0 ||
+#ifdef IORING_SETUP_COOP_TASKRUN
+            PyModule_AddIntMacro(m, IORING_SETUP_COOP_TASKRUN) < 0 ||
+            PyModule_AddIntMacro(m, IORING_SETUP_TASKRUN_FLAG) < 0 ||
+#endif
+#ifdef IORING_SETUP_SINGLE_ISSUER
+            PyModule_AddIntMacro(m, IORING_SETUP_SINGLE_ISSUER) < 0 ||
+#endif
+#ifdef IORING_SETUP_DEFER_TASKRUN
+            PyModule_AddIntMacro(m, IORING_SETUP_DEFER_TASKRUN) < 0 ||
+#endif
+            PyModule_AddIntMacro(m, IORING_FEAT_SINGLE_MMAP) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_NODROP) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_SUBMIT_STABLE) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_RW_CUR_POS) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_CUR_PERSONALITY) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_FAST_POLL) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_POLL_32BITS) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_SQPOLL_NONFIXED) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_EXT_ARG) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_NATIVE_WORKERS) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FEAT_RSRC_TAGS) < 0 ||
+            PyModule_AddIntMacro(m, IOSQE_FIXED_FILE) < 0 ||
+            PyModule_AddIntMacro(m, IOSQE_IO_DRAIN) < 0 ||
+            PyModule_AddIntMacro(m, IOSQE_IO_LINK) < 0 ||
+            PyModule_AddIntMacro(m, IOSQE_IO_HARDLINK) < 0 ||
+            PyModule_AddIntMacro(m, IOSQE_ASYNC) < 0 ||
+            PyModule_AddIntMacro(m, IORING_CQE_F_BUFFER) < 0 ||
+            PyModule_AddIntMacro(m, IORING_CQE_F_MORE) < 0 ||
+            PyModule_AddIntMacro(m, IORING_FSYNC_DATASYNC) < 0 ||
+            PyModule_AddIntMacro(m, AT_FDCWD) < 0 ||
+            PyModule_AddIntMacro(m, AT_EMPTY_PATH) < 0 ||
+            PyModule_AddIntMacro(m, AT_SYMLINK_NOFOLLOW) < 0 ||
+            PyModule_AddIntMacro(m, AT_REMOVEDIR) < 0 ||
+            PyModule_AddIntMacro(m, AT_STATX_SYNC_AS_STAT) < 0 ||
+            PyModule_AddIntMacro(m, AT_STATX_FORCE_SYNC) < 0 ||
+            PyModule_AddIntMacro(m, AT_STATX_DONT_SYNC) < 0 ||
+            PyModule_AddIntMacro(m, STATX_BASIC_STATS) < 0 ||
+            PyModule_AddIntMacro(m, STATX_BTIME) < 0 ||
+            PyModule_AddIntMacro(m, STATX_ALL) < 0 ||
+            PyModule_AddIntMacro(m, SYNC_FILE_RANGE_WAIT_BEFORE) < 0 ||
+            PyModule_AddIntMacro(m, SYNC_FILE_RANGE_WRITE) < 0 ||
+            PyModule_AddIntMacro(m, SYNC_FILE_RANGE_WAIT_AFTER) < 0 ||
+            PyModule_AddIntMacro(m, FALLOC_FL_KEEP_SIZE) < 0 ||
+            PyModule_AddIntMacro(m, FALLOC_FL_PUNCH_HOLE) < 0 ||
+            PyModule_AddIntMacro(m, FALLOC_FL_ZERO_RANGE) < 0 ||
+            PyModule_AddIntMacro(m, RENAME_NOREPLACE) < 0 ||
+            PyModule_AddIntMacro(m, RENAME_EXCHANGE) < 0 ||
+            PyModule_AddIntMacro(m, SPLICE_F_MOVE) < 0 ||
+            PyModule_AddIntMacro(m, SPLICE_F_NONBLOCK) < 0 ||
+            PyModule_AddIntMacro(m, SPLICE_F_MORE) < 0 ||
+            PyModule_AddIntMacro(m, SPLICE_F_FD_IN_FIXED) < 0 ||
+            PyModule_AddIntMacro(m, ACCEPT_ADDR) < 0 ||
+            PyModule_AddIntMacro(m, ACCEPT_RESULT_ADDR) < 0 ||
+            PyModule_AddIntMacro(m, ACCEPT_NO_ADDR) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_NOP) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_READ) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_WRITE) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_READV) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_WRITEV) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_RECV) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_SEND) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_FSYNC) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_CLOSE) < 0 ||
+            PyModule_AddIntMacro(m, IORING_OP_TIMEOUT) < 0
+    )
+    {
+        return -1;
+    }
+    return 0;
+}
+
 PyMODINIT_FUNC
 PyInit_py_io_uring(void)
 {
@@ -936,17 +6429,67 @@ PyInit_py_io_uring(void)
     if (PyType_Ready(&CqeType) < 0) {
         return NULL;
     }
+    if (PyType_Ready(&BufferPoolType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&BufferRingType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&ProvidedBufferType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&ProxyType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&FileStreamType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&RingGroupType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&TimerWheelType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&AlignedBufferType) < 0) {
+        return NULL;
+    }
+    if (StatxResultType.tp_name == NULL
+            && PyStructSequence_InitType2(&StatxResultType, &statx_result_desc) < 0) {
+        return NULL;
+    }
     m = PyModule_Create(&PyIoUringModule);
     if (m == NULL) {
         return NULL;
     }
+    if (add_constants(m) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
     Py_INCREF(&IoUringType);
     Py_INCREF(&SqeType);
     Py_INCREF(&CqeType);
+    Py_INCREF(&BufferPoolType);
+    Py_INCREF(&BufferRingType);
+    Py_INCREF(&ProvidedBufferType);
+    Py_INCREF(&StatxResultType);
+    Py_INCREF(&ProxyType);
+    Py_INCREF(&FileStreamType);
+    Py_INCREF(&AlignedBufferType);
+    Py_INCREF(&RingGroupType);
+    Py_INCREF(&TimerWheelType);
     if (
             PyModule_AddObject(m, "IoUring", (PyObject *) &IoUringType) < 0 ||
             PyModule_AddObject(m, "Sqe", (PyObject *) &SqeType) < 0 ||
-            PyModule_AddObject(m, "Cqe", (PyObject *) &CqeType) < 0
+            PyModule_AddObject(m, "Cqe", (PyObject *) &CqeType) < 0 ||
+            PyModule_AddObject(m, "BufferPool", (PyObject *) &BufferPoolType) < 0 ||
+            PyModule_AddObject(m, "BufferRing", (PyObject *) &BufferRingType) < 0 ||
+            PyModule_AddObject(m, "ProvidedBuffer", (PyObject *) &ProvidedBufferType) < 0 ||
+            PyModule_AddObject(m, "StatxResult", (PyObject *) &StatxResultType) < 0 ||
+            PyModule_AddObject(m, "Proxy", (PyObject *) &ProxyType) < 0 ||
+            PyModule_AddObject(m, "FileStream", (PyObject *) &FileStreamType) < 0 ||
+            PyModule_AddObject(m, "AlignedBuffer", (PyObject *) &AlignedBufferType) < 0 ||
+            PyModule_AddObject(m, "RingGroup", (PyObject *) &RingGroupType) < 0 ||
+            PyModule_AddObject(m, "TimerWheel", (PyObject *) &TimerWheelType) < 0
     )
     {
         goto error;
@@ -956,6 +6499,15 @@ error:
     Py_DECREF(&IoUringType);
     Py_DECREF(&SqeType);
     Py_DECREF(&CqeType);
+    Py_DECREF(&BufferPoolType);
+    Py_DECREF(&BufferRingType);
+    Py_DECREF(&ProvidedBufferType);
+    Py_DECREF(&StatxResultType);
+    Py_DECREF(&ProxyType);
+    Py_DECREF(&FileStreamType);
+    Py_DECREF(&AlignedBufferType);
+    Py_DECREF(&RingGroupType);
+    Py_DECREF(&TimerWheelType);
     Py_DECREF(m);
     return NULL;
 }
@@ -0,0 +1,618 @@
+"""drive an IoUring from an asyncio event loop.
+
+the ring signals an eventfd when completions are posted, the eventfd is
+watched by loop.add_reader, so no thread is needed to wait for completions.
+
+    aring = AsyncRing(ring)
+    sqe, fut = aring.prepare()
+    sqe.prep_recv(fd, 1024)
+    data = await fut
+
+IoUringEventLoop goes further, its socket operations and transports are
+completion based, all submissions of one loop iteration go to kernel by a
+single submit right before polling.
+
+    asyncio.set_event_loop_policy(IoUringEventLoopPolicy())
+"""
+import asyncio
+import errno
+import os
+import selectors
+import socket
+
+from py_io_uring import IoUring, IORING_CQE_F_MORE, ACCEPT_RESULT_ADDR
+
+
+class AsyncRing:
+
+    def __init__(self, ring, loop=None, async_only=False):
+        """ring must be initialized by queue_init. with async_only the eventfd
+        is registered by register_eventfd_async, completions posted inline
+        during submit are reaped right after submit instead."""
+        self.ring = ring
+        self.loop = loop or asyncio.get_event_loop()
+        self._submit_scheduled = False
+        if hasattr(os, "eventfd"):
+            self._efd = os.eventfd(0, os.EFD_NONBLOCK | os.EFD_CLOEXEC)
+            if async_only:
+                ring.register_eventfd_async(self._efd)
+            else:
+                ring.register_eventfd(self._efd)
+            self.loop.add_reader(self._efd, self._ready)
+        else:
+            # without os.eventfd, poll the ring fd itself
+            self._efd = None
+            self.loop.add_reader(ring.fileno(), self._ready)
+
+    def prepare(self):
+        """return (sqe, future), the future is resolved with the result of the
+        operation prepared on sqe, or OSError when it fails. sqes prepared
+        in the same loop iteration are submitted at once. cancelling the
+        future cancels the operation."""
+        sqe = self._get_sqe()
+        fut = self.loop.create_future()
+        sqe.set_data(fut)
+        fut.add_done_callback(lambda fut: fut.cancelled() and self._cancel(sqe))
+        self._schedule_submit()
+        return sqe, fut
+
+    def prepare_callback(self, callback):
+        """return sqe, callback(res, flags) is called for each completion of it,
+        res is a negative errno on failure. suits multishot operations."""
+        sqe = self._get_sqe()
+        sqe.set_data(callback)
+        self._schedule_submit()
+        return sqe
+
+    def close(self):
+        if self._efd is not None:
+            self.loop.remove_reader(self._efd)
+            self.ring.unregister_eventfd()
+            os.close(self._efd)
+            self._efd = None
+        else:
+            self.loop.remove_reader(self.ring.fileno())
+
+    def _get_sqe(self):
+        try:
+            return self.ring.get_sqe()
+        except OSError as e:
+            if e.errno != errno.EBUSY:
+                raise
+        # submission queue is full, flush it now instead of next iteration
+        self.ring.submit()
+        return self.ring.get_sqe()
+
+    def _cancel(self, target):
+        sqe = self._get_sqe()
+        sqe.prep_cancel(target, 0)
+        self._schedule_submit()
+
+    def _schedule_submit(self):
+        if not self._submit_scheduled:
+            self._submit_scheduled = True
+            self.loop.call_soon(self._submit)
+
+    def _submit(self):
+        self._submit_scheduled = False
+        self.ring.submit()
+        self._reap()
+
+    def _ready(self):
+        if self._efd is not None:
+            try:
+                os.eventfd_read(self._efd)
+            except BlockingIOError:
+                pass
+        self._reap()
+
+    def _reap(self):
+        for data, res, flags in self.ring.drain():
+            if isinstance(data, asyncio.Future):
+                if data.done():
+                    continue
+                if isinstance(res, int) and res < 0:
+                    data.set_exception(OSError(-res, os.strerror(-res)))
+                else:
+                    data.set_result(res)
+            elif callable(data):
+                # one failing callback must not lose the rest of the batch
+                try:
+                    data(res, flags)
+                except (SystemExit, KeyboardInterrupt):
+                    raise
+                except BaseException as exc:
+                    self.loop.call_exception_handler({
+                        'message': 'Exception in io_uring completion callback',
+                        'exception': exc,
+                    })
+
+
+class _SubmittingSelector(selectors.DefaultSelector):
+    """submit sqes prepared during a loop iteration right before polling."""
+
+    def __init__(self, ring):
+        super().__init__()
+        self._ring = ring
+
+    def select(self, timeout=None):
+        if self._ring.sq_ready():
+            self._ring.submit()
+        return super().select(timeout)
+
+
+class _LoopRing(AsyncRing):
+
+    def _schedule_submit(self):
+        # submitted by _SubmittingSelector
+        pass
+
+
+def _server_attach(server, transport):
+    # Server._attach takes the transport since python 3.13
+    try:
+        server._attach(transport)
+    except TypeError:
+        server._attach()
+
+
+def _server_detach(server, transport):
+    try:
+        server._detach(transport)
+    except TypeError:
+        server._detach()
+
+
+def _set_nodelay(sock):
+    if sock.family in (socket.AF_INET, socket.AF_INET6):
+        try:
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        except OSError:
+            pass
+
+
+def _errno_error(res):
+    return OSError(-res, os.strerror(-res))
+
+
+class _RingTransport(asyncio.Transport):
+    """socket transport which reads by recv and writes by send operations,
+    at most one of each is in flight."""
+
+    max_size = 256 * 1024
+
+    def __init__(self, loop, sock, protocol, waiter=None, extra=None, server=None):
+        super().__init__(extra)
+        self._extra['socket'] = sock
+        try:
+            self._extra['sockname'] = sock.getsockname()
+        except OSError:
+            self._extra['sockname'] = None
+        if 'peername' not in self._extra:
+            try:
+                self._extra['peername'] = sock.getpeername()
+            except OSError:
+                self._extra['peername'] = None
+        self._loop = loop
+        self._sock = sock
+        self._fd = sock.fileno()
+        self._protocol = protocol
+        self._buffered = isinstance(protocol, asyncio.BufferedProtocol)
+        self._server = server
+        self._closing = False
+        self._lost = False
+        self._paused = False
+        self._recv_sqe = None
+        self._pending_recv = None
+        self._write_buffer = bytearray()
+        self._sending = None
+        self._eof = False
+        self._protocol_paused = False
+        self.set_write_buffer_limits()
+        if server is not None:
+            _server_attach(server, self)
+        loop.call_soon(protocol.connection_made, self)
+        loop.call_soon(self._recv)
+        if waiter is not None:
+            loop.call_soon(lambda: waiter.cancelled() or waiter.set_result(None))
+
+    def get_protocol(self):
+        return self._protocol
+
+    def set_protocol(self, protocol):
+        self._protocol = protocol
+        self._buffered = isinstance(protocol, asyncio.BufferedProtocol)
+
+    def is_closing(self):
+        return self._closing
+
+    def is_reading(self):
+        return not self._paused and not self._closing
+
+    def pause_reading(self):
+        # the recv in flight is not cancelled, its data is kept until resumed
+        if self._closing or self._paused:
+            return
+        self._paused = True
+
+    def resume_reading(self):
+        if self._closing or not self._paused:
+            return
+        self._paused = False
+        if self._pending_recv is not None:
+            res, self._pending_recv = self._pending_recv, None
+            self._loop.call_soon(self._deliver, res)
+        else:
+            self._recv()
+
+    def _recv(self):
+        if self._closing or self._paused or self._recv_sqe is not None:
+            return
+        if self._buffered:
+            try:
+                buf = self._protocol.get_buffer(-1)
+                if not len(buf):
+                    raise RuntimeError('get_buffer() returned an empty buffer')
+            except (SystemExit, KeyboardInterrupt):
+                raise
+            except BaseException as exc:
+                self._fatal_error(exc, 'Fatal error: protocol.get_buffer() call failed.')
+                return
+        sqe = self._loop._aring.prepare_callback(self._on_recv)
+        if self._buffered:
+            sqe.prep_recv_into(self._fd, buf)
+        else:
+            sqe.prep_recv(self._fd, self.max_size)
+        self._recv_sqe = sqe
+
+    def _on_recv(self, res, flags):
+        self._recv_sqe = None
+        if self._closing:
+            return
+        if isinstance(res, int) and res < 0:
+            self._fatal_error(_errno_error(res), 'Fatal read error on socket transport')
+            return
+        if self._paused:
+            self._pending_recv = res
+            return
+        self._deliver(res)
+
+    def _deliver(self, res):
+        if self._closing:
+            return
+        if not res:
+            self._eof_received()
+            return
+        try:
+            if self._buffered:
+                self._protocol.buffer_updated(res)
+            else:
+                self._protocol.data_received(res)
+        except (SystemExit, KeyboardInterrupt):
+            raise
+        except BaseException as exc:
+            self._fatal_error(exc, 'Fatal error: protocol.data_received() call failed.')
+            return
+        self._recv()
+
+    def _eof_received(self):
+        try:
+            keep_open = self._protocol.eof_received()
+        except (SystemExit, KeyboardInterrupt):
+            raise
+        except BaseException as exc:
+            self._fatal_error(exc, 'Fatal error: protocol.eof_received() call failed.')
+            return
+        if not keep_open:
+            self.close()
+
+    def write(self, data):
+        if not isinstance(data, (bytes, bytearray, memoryview)):
+            raise TypeError('data argument must be a bytes-like object, not %r'
+                    % type(data).__name__)
+        if self._eof:
+            raise RuntimeError('Cannot call write() after write_eof()')
+        if self._closing or not data:
+            return
+        self._write_buffer += data
+        self._send()
+        self._maybe_pause_protocol()
+
+    def _send(self):
+        if self._sending is not None or not self._write_buffer:
+            return
+        # the buffer is pinned by the sqe while in flight, write to a new one
+        self._sending, self._write_buffer = self._write_buffer, bytearray()
+        sqe = self._loop._aring.prepare_callback(self._on_send)
+        sqe.prep_send(self._fd, self._sending)
+
+    def _on_send(self, res, flags):
+        data, self._sending = self._sending, None
+        if self._lost:
+            return
+        if res < 0:
+            self._fatal_error(_errno_error(res), 'Fatal write error on socket transport')
+            return
+        if res < len(data):
+            del data[:res]
+            data += self._write_buffer
+            self._write_buffer = data
+        self._maybe_resume_protocol()
+        if self._write_buffer:
+            self._send()
+        elif self._closing:
+            self._call_connection_lost(None)
+        elif self._eof:
+            self._shutdown_write()
+
+    def _shutdown_write(self):
+        try:
+            self._sock.shutdown(socket.SHUT_WR)
+        except OSError as exc:
+            self._fatal_error(exc, 'Fatal error on shutdown')
+
+    def writelines(self, list_of_data):
+        for data in list_of_data:
+            self.write(data)
+
+    def can_write_eof(self):
+        return True
+
+    def write_eof(self):
+        if self._closing or self._eof:
+            return
+        self._eof = True
+        if self._sending is None:
+            self._shutdown_write()
+
+    def get_write_buffer_size(self):
+        size = len(self._write_buffer)
+        if self._sending is not None:
+            size += len(self._sending)
+        return size
+
+    def get_write_buffer_limits(self):
+        return (self._low_water, self._high_water)
+
+    def set_write_buffer_limits(self, high=None, low=None):
+        if high is None:
+            high = 64 * 1024 if low is None else 4 * low
+        if low is None:
+            low = high // 4
+        if not high >= low >= 0:
+            raise ValueError('high (%r) must be >= low (%r) must be >= 0' % (high, low))
+        self._high_water = high
+        self._low_water = low
+        self._maybe_pause_protocol()
+
+    def _maybe_pause_protocol(self):
+        if self._protocol_paused or self.get_write_buffer_size() <= self._high_water:
+            return
+        self._protocol_paused = True
+        try:
+            self._protocol.pause_writing()
+        except (SystemExit, KeyboardInterrupt):
+            raise
+        except BaseException as exc:
+            self._loop.call_exception_handler({
+                'message': 'protocol.pause_writing() failed',
+                'exception': exc,
+                'transport': self,
+                'protocol': self._protocol,
+            })
+
+    def _maybe_resume_protocol(self):
+        if not self._protocol_paused or self.get_write_buffer_size() > self._low_water:
+            return
+        self._protocol_paused = False
+        try:
+            self._protocol.resume_writing()
+        except (SystemExit, KeyboardInterrupt):
+            raise
+        except BaseException as exc:
+            self._loop.call_exception_handler({
+                'message': 'protocol.resume_writing() failed',
+                'exception': exc,
+                'transport': self,
+                'protocol': self._protocol,
+            })
+
+    def _cancel_recv(self):
+        if self._recv_sqe is not None:
+            self._loop._aring._cancel(self._recv_sqe)
+
+    def close(self):
+        if self._closing:
+            return
+        self._closing = True
+        self._cancel_recv()
+        if self._sending is None:
+            self._loop.call_soon(self._call_connection_lost, None)
+
+    def abort(self):
+        self._force_close(None)
+
+    def _fatal_error(self, exc, message):
+        # connection errors are reported by connection_lost only
+        if not isinstance(exc, OSError):
+            self._loop.call_exception_handler({
+                'message': message,
+                'exception': exc,
+                'transport': self,
+                'protocol': self._protocol,
+            })
+        self._force_close(exc)
+
+    def _force_close(self, exc):
+        if self._lost:
+            return
+        self._write_buffer = bytearray()
+        if not self._closing:
+            self._closing = True
+            self._cancel_recv()
+        # an abort does not wait for the send in flight
+        self._lost = True
+        self._loop.call_soon(self._connection_lost, exc)
+
+    def _call_connection_lost(self, exc):
+        if self._lost:
+            return
+        self._lost = True
+        self._connection_lost(exc)
+
+    def _connection_lost(self, exc):
+        try:
+            self._protocol.connection_lost(exc)
+        finally:
+            # operations in flight hold their own reference to the file
+            self._sock.close()
+            self._sock = None
+            self._protocol = None
+            server, self._server = self._server, None
+            if server is not None:
+                _server_detach(server, self)
+
+
+class _Acceptor:
+    """multishot accept on a listening socket, re-armed when terminated."""
+
+    retry_delay = 1
+
+    def __init__(self, loop, protocol_factory, sock, server):
+        self.loop = loop
+        self.protocol_factory = protocol_factory
+        self.sock = sock
+        self.server = server
+        self.sqe = None
+        self.stopped = False
+
+    def arm(self):
+        if self.stopped or self.sqe is not None:
+            return
+        self.sqe = self.loop._aring.prepare_callback(self._on_accept)
+        self.sqe.prep_multishot_accept(self.sock.fileno(),
+                socket.SOCK_NONBLOCK | socket.SOCK_CLOEXEC)
+
+    def stop(self):
+        self.stopped = True
+        if self.sqe is not None:
+            self.loop._aring._cancel(self.sqe)
+
+    def _on_accept(self, res, flags):
+        if not flags & IORING_CQE_F_MORE:
+            self.sqe = None
+        if res < 0:
+            if self.stopped or res == -errno.ECANCELED:
+                return
+            if res not in (-errno.ECONNABORTED, -errno.EAGAIN, -errno.EINTR):
+                # a persistent error would fail again at once, back off
+                if res in (-errno.EMFILE, -errno.ENFILE, -errno.ENOBUFS, -errno.ENOMEM):
+                    message = 'socket.accept() out of system resource'
+                else:
+                    message = 'socket.accept() failed'
+                self.loop.call_exception_handler({
+                    'message': message,
+                    'exception': _errno_error(res),
+                    'socket': self.sock,
+                })
+                if self.sqe is None:
+                    self.loop.call_later(self.retry_delay, self.arm)
+                return
+        elif self.stopped:
+            os.close(res)
+            return
+        else:
+            self._connection_made(res)
+        if self.sqe is None:
+            self.arm()
+
+    def _connection_made(self, fd):
+        conn = socket.socket(fileno=fd)
+        try:
+            _set_nodelay(conn)
+            protocol = self.protocol_factory()
+            self.loop._make_socket_transport(conn, protocol, server=self.server)
+        except (SystemExit, KeyboardInterrupt):
+            raise
+        except BaseException as exc:
+            conn.close()
+            self.loop.call_exception_handler({
+                'message': 'Error on transport creation for incoming connection',
+                'exception': exc,
+            })
+
+
+class IoUringEventLoop(asyncio.SelectorEventLoop):
+    """selector event loop whose socket operations, socket transports and
+    servers are driven by io_uring. ssl and other kinds of file descriptor
+    are still served by readiness notification."""
+
+    def __init__(self, entries=256):
+        ring = IoUring()
+        ring.queue_init(entries)
+        self._ring = ring
+        self._acceptors = {}
+        super().__init__(_SubmittingSelector(ring))
+        self._aring = _LoopRing(ring, self)
+
+    def close(self):
+        if self.is_running():
+            raise RuntimeError('Cannot close a running event loop')
+        if self.is_closed():
+            return
+        self._aring.close()
+        super().close()
+        self._ring.queue_exit()
+
+    async def _submit(self, prep, *args):
+        sqe, fut = self._aring.prepare()
+        getattr(sqe, prep)(*args)
+        return await fut
+
+    async def sock_recv(self, sock, n):
+        return await self._submit('prep_recv', sock.fileno(), n)
+
+    async def sock_recv_into(self, sock, buf):
+        return await self._submit('prep_recv_into', sock.fileno(), buf)
+
+    async def sock_sendall(self, sock, data):
+        view = memoryview(data).cast('B')
+        sent = 0
+        while sent < len(view):
+            sent += await self._submit('prep_send', sock.fileno(), view[sent:])
+
+    async def sock_accept(self, sock):
+        fd, addr = await self._submit('prep_accept', sock.fileno(),
+                socket.SOCK_NONBLOCK | socket.SOCK_CLOEXEC, ACCEPT_RESULT_ADDR)
+        return socket.socket(fileno=fd), addr
+
+    async def sock_connect(self, sock, address):
+        if sock.family in (socket.AF_INET, socket.AF_INET6):
+            resolved = await self._ensure_resolved(address, family=sock.family,
+                    type=sock.type, proto=sock.proto, loop=self)
+            _, _, _, _, address = resolved[0]
+        elif sock.family != socket.AF_UNIX:
+            return await super().sock_connect(sock, address)
+        await self._submit('prep_connect', sock.fileno(), address)
+
+    def _make_socket_transport(self, sock, protocol, waiter=None, *, extra=None, server=None):
+        return _RingTransport(self, sock, protocol, waiter, extra, server)
+
+    def _start_serving(self, protocol_factory, sock, sslcontext=None, server=None,
+            backlog=100, *args, **kwargs):
+        if sslcontext is not None:
+            return super()._start_serving(protocol_factory, sock, sslcontext, server,
+                    backlog, *args, **kwargs)
+        acceptor = _Acceptor(self, protocol_factory, sock, server)
+        self._acceptors[sock.fileno()] = acceptor
+        acceptor.arm()
+
+    def _stop_serving(self, sock):
+        acceptor = self._acceptors.pop(sock.fileno(), None)
+        if acceptor is not None:
+            acceptor.stop()
+        super()._stop_serving(sock)
+
+
+class IoUringEventLoopPolicy(asyncio.DefaultEventLoopPolicy):
+    _loop_factory = IoUringEventLoop
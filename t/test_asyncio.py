@@ -0,0 +1,108 @@
+import asyncio
+import errno
+import unittest
+from socket import *
+
+from py_io_uring import IoUring, IORING_CQE_F_MORE
+from py_io_uring_asyncio import AsyncRing
+
+class TestAsyncRing(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.loop = asyncio.new_event_loop()
+        self.rsock, self.wsock = socketpair()
+
+    def run_with(self, coro_func, **kwargs):
+        async def main():
+            aring = AsyncRing(self.ring, self.loop, **kwargs)
+            try:
+                return await coro_func(aring)
+            finally:
+                aring.close()
+        return self.loop.run_until_complete(asyncio.wait_for(main(), 5))
+
+    def test_recv_send(self):
+        async def echo(aring):
+            sqe, recv = aring.prepare()
+            sqe.prep_recv(self.rsock.fileno(), 1024)
+            sqe, send = aring.prepare()
+            sqe.prep_send(self.wsock.fileno(), b"hello world")
+            self.assertEqual(await send, 11)
+            return await recv
+        self.assertEqual(self.run_with(echo), b"hello world")
+
+    def test_async_only(self):
+        async def nops(aring):
+            futs = []
+            for i in range(40):
+                sqe, fut = aring.prepare()
+                sqe.prep_nop()
+                futs.append(fut)
+            return await asyncio.gather(*futs)
+        self.assertEqual(self.run_with(nops, async_only=True), [None] * 40)
+
+    def test_error(self):
+        async def recv(aring):
+            sqe, fut = aring.prepare()
+            sqe.prep_recv(-1, 1024)
+            await fut
+        with self.assertRaises(OSError) as cm:
+            self.run_with(recv)
+        self.assertEqual(cm.exception.errno, errno.EBADF)
+
+    def test_cancel(self):
+        async def recv(aring):
+            sqe, fut = aring.prepare()
+            sqe.prep_recv(self.rsock.fileno(), 1024)
+            await asyncio.sleep(0.01)
+            fut.cancel()
+            # cancelled recv must not consume the data
+            await asyncio.sleep(0.01)
+            sqe, fut = aring.prepare()
+            sqe.prep_recv(self.rsock.fileno(), 1024)
+            self.wsock.send(b"after")
+            return await fut
+        self.assertEqual(self.run_with(recv), b"after")
+
+    def test_multishot_callback(self):
+        server = socket(AF_INET, SOCK_STREAM, 0)
+        server.bind(('127.0.0.1', 0))
+        server.listen(5)
+
+        async def accept(aring):
+            done = self.loop.create_future()
+            accepted = []
+            def on_accept(res, flags):
+                self.assertTrue(flags & IORING_CQE_F_MORE)
+                accepted.append(res)
+                if len(accepted) == 3:
+                    done.set_result(accepted)
+            sqe = aring.prepare_callback(on_accept)
+            sqe.prep_multishot_accept(server.fileno())
+            clients = []
+            for i in range(3):
+                c = socket(AF_INET, SOCK_STREAM, 0)
+                c.setblocking(False)
+                await self.loop.sock_connect(c, server.getsockname())
+                clients.append(c)
+            fds = await done
+            for fd in fds:
+                socket(fileno=fd).close()
+            for c in clients:
+                c.close()
+            return len(fds)
+        with server:
+            self.assertEqual(self.run_with(accept), 3)
+
+    def tearDown(self):
+        self.rsock.close()
+        self.wsock.close()
+        self.loop.close()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,7 +1,12 @@
+import errno
+import mmap
+import os
+import tempfile
 import unittest
 from socket import *
 import time
 
+import py_io_uring
 from py_io_uring import IoUring
 
 class TestBasic(unittest.TestCase):
@@ -120,6 +125,325 @@ class TestBasic(unittest.TestCase):
         for cqe in cqes:
             ring.cqe_seen(cqe)
 
+    def test_wait_cqe_nr_wrap(self):
+        ring = self.ring
+        # completion queue has 64 entries, fill it in chunks so that
+        # the harvested cqes wrap around the end of the ring
+        for n in range(10):
+            for i in range(20):
+                sqe = ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_data(i)
+            ring.submit()
+            cqes = ring.wait_cqe_nr(20)
+            self.assertEqual([cqe.get_data() for cqe in cqes], list(range(20)))
+            for cqe in cqes:
+                ring.cqe_seen(cqe)
+        self.assertEqual(ring.cq_ready(), 0)
+
+    def test_peek_batch(self):
+        ring = self.ring
+        self.assertEqual(ring.peek_batch(8), [])
+        for i in range(5):
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data(i)
+        ring.submit()
+        ring.wait_cqe_nr(5)
+
+        results = ring.peek_batch(3)
+        self.assertEqual(results, [(0, None, 0), (1, None, 0), (2, None, 0)])
+        self.assertEqual(ring.cq_ready(), 2)
+        results = ring.peek_batch(8)
+        self.assertEqual([r[0] for r in results], [3, 4])
+        self.assertEqual(ring.cq_ready(), 0)
+
+    def test_drain(self):
+        ring = self.ring
+        for n in range(10):
+            for i in range(20):
+                sqe = ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_data(i)
+            ring.submit()
+            results = ring.drain(20)
+            self.assertEqual([r[0] for r in results], list(range(20)))
+        self.assertEqual(ring.drain(), [])
+
+    def test_drain_seen_cqe(self):
+        ring = self.ring
+        for i in range(2):
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data(i)
+        ring.submit()
+        cqe = ring.wait_cqe()
+        self.assertEqual(len(ring.drain(2)), 2)
+        # cqe has been harvested, mark it seen again must not skip others
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        ring.submit()
+        ring.cqe_seen(cqe)
+        self.assertEqual(ring.cq_ready(), 1)
+        self.assertEqual(ring.drain(1), [(None, None, 0)])
+
+    def test_drain_failure(self):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        sqe.prep_close(-1)
+        ring.submit()
+        [(data, res, flags)] = ring.drain(1)
+        self.assertLess(res, 0)
+
+    def test_sqe_recycled(self):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        first = id(sqe)
+        sqe.prep_nop()
+        ring.submit()
+        self.assertRaises(ValueError, sqe.prep_nop)
+        del sqe
+        ring.drain(1)
+        sqe = ring.get_sqe()
+        self.assertEqual(id(sqe), first)
+        sqe.prep_nop()
+        ring.submit()
+        ring.drain(1)
+
+    def test_sqe_held_by_user(self):
+        ring = self.ring
+        held = ring.get_sqe()
+        held.prep_nop()
+        held.set_data("held")
+        ring.submit()
+        ring.drain(1)
+        sqe = ring.get_sqe()
+        self.assertIsNot(sqe, held)
+        sqe.prep_nop()
+        sqe.set_data("new")
+        ring.submit()
+        self.assertEqual(ring.drain(1), [("new", None, 0)])
+        self.assertRaises(ValueError, held.prep_nop)
+
+    def test_sqe_slots_grow(self):
+        ring = self.ring
+        # more operations in flight than sq + cq entries
+        for n in range(4):
+            for i in range(32):
+                sqe = ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_data(n * 32 + i)
+            ring.submit()
+        results = []
+        while len(results) < 128:
+            results += ring.drain(1)
+        self.assertEqual(sorted(r[0] for r in results), list(range(128)))
+
+    def test_ring_dropped_in_flight(self):
+        fds = len(os.listdir("/proc/self/fd"))
+        r, w = os.pipe()
+        ring = IoUring()
+        ring.queue_init(4, 0)
+        buf = bytearray(16)
+        sqe = ring.get_sqe()
+        sqe.prep_read_into(r, buf)
+        ring.submit()
+        del sqe, ring
+        # the read is dropped with the ring, which keeps buf until then
+        os.write(w, b"late")
+        os.set_blocking(r, False)
+        self.assertEqual(os.read(r, 4), b"late")
+        self.assertEqual(buf, bytearray(16))
+        os.close(r)
+        os.close(w)
+        self.assertEqual(len(os.listdir("/proc/self/fd")), fds)
+
+    def test_queue_exit_twice(self):
+        ring = IoUring()
+        ring.queue_init(4, 0)
+        ring.queue_exit()
+        ring.queue_exit()
+        self.assertEqual(ring.features(), 0)
+
+    def test_sq_full(self):
+        ring = self.ring
+        for i in range(32):
+            ring.get_sqe().prep_nop()
+        self.assertRaises(OSError, ring.get_sqe)
+        ring.submit()
+        results = []
+        while len(results) < 32:
+            results += ring.drain(1)
+
+    def test_prep_cancel(self):
+        ring = self.ring
+        timeout = ring.get_sqe()
+        timeout.prep_timeout(10)
+        timeout.set_data("timeout")
+        ring.submit()
+        sqe = ring.get_sqe()
+        sqe.prep_cancel(timeout, 0)
+        sqe.set_data("cancel")
+        ring.submit()
+        results = dict((data, res) for data, res, flags in ring.drain(2))
+        self.assertEqual(results["cancel"], 0)
+        self.assertEqual(results["timeout"], -errno.ECANCELED)
+
+    def test_prep_read_into(self):
+        ring = self.ring
+        with tempfile.TemporaryFile() as f:
+            f.write(b"hello world")
+            f.flush()
+            buf = bytearray(5)
+            sqe = ring.get_sqe()
+            sqe.prep_read_into(f.fileno(), buf, 6)
+            ring.submit()
+            cqe = ring.wait_cqe()
+            self.assertEqual(cqe.getresult(), 5)
+            ring.cqe_seen(cqe)
+            self.assertEqual(buf, b"world")
+
+    def test_prep_into_too_large(self):
+        # pages of an anonymous mapping are not allocated until touched
+        with mmap.mmap(-1, (1 << 32) + 1) as buf:
+            sqe = self.ring.get_sqe()
+            self.assertRaises(OverflowError, sqe.prep_read_into, 0, buf)
+            self.assertRaises(OverflowError, sqe.prep_recv_into, 0, buf)
+            self.assertRaises(OverflowError, sqe.prep_write, 0, buf)
+        sqe.prep_nop()
+        self.ring.submit()
+        self.ring.drain(1)
+
+    def test_link(self):
+        ring = self.ring
+        buf = bytearray(1)
+        for flag, res in ((py_io_uring.IOSQE_IO_LINK, -errno.ECANCELED),
+                (py_io_uring.IOSQE_IO_HARDLINK, None)):
+            sqe = ring.get_sqe()
+            sqe.prep_read_into(-1, buf, 0)
+            sqe.set_flags(flag)
+            sqe.set_data("read")
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data("nop")
+            ring.submit()
+            self.assertEqual(ring.drain(2),
+                    [("read", -errno.EBADF, 0), ("nop", res, 0)])
+
+    def test_link_timeout(self):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        sqe.prep_timeout(10)
+        sqe.set_flags(py_io_uring.IOSQE_IO_LINK)
+        sqe.set_data("timeout")
+        sqe = ring.get_sqe()
+        sqe.prep_link_timeout(0.01)
+        sqe.set_data("link_timeout")
+        ring.submit()
+        results = dict((data, res) for data, res, flags in ring.drain(2))
+        self.assertEqual(results["timeout"], -errno.ECANCELED)
+        self.assertEqual(results["link_timeout"], -errno.ETIME)
+
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_flags(py_io_uring.IOSQE_IO_LINK)
+        sqe = ring.get_sqe()
+        sqe.prep_link_timeout(10)
+        ring.submit()
+        self.assertEqual([res for data, res, flags in ring.drain(2)], [None, -errno.ECANCELED])
+
+    def test_set_flags(self):
+        sqe = self.ring.get_sqe()
+        sqe.prep_nop()
+        self.assertRaises(ValueError, sqe.set_flags, 1 << 6)
+        sqe.set_flags(py_io_uring.IOSQE_IO_DRAIN | py_io_uring.IOSQE_ASYNC)
+        self.ring.submit()
+        self.assertEqual(self.ring.drain(1), [(None, None, 0)])
+        self.assertRaises(ValueError, sqe.set_flags, py_io_uring.IOSQE_IO_LINK)
+
+    def test_readv_writev(self):
+        ring = self.ring
+        offset = 5 << 30
+        with tempfile.TemporaryFile() as f:
+            sqe = ring.get_sqe()
+            sqe.prep_writev(f.fileno(), [b"header", bytearray(b"body"), memoryview(b"trailer")],
+                    offset, os.RWF_DSYNC)
+            ring.submit()
+            self.assertEqual(ring.drain(1), [(None, 17, 0)])
+            self.assertEqual(os.pread(f.fileno(), 17, offset), b"headerbodytrailer")
+
+            head, body = bytearray(6), bytearray(20)
+            sqe = ring.get_sqe()
+            sqe.prep_readv(f.fileno(), [head, memoryview(body)[:4]], offset)
+            ring.submit()
+            self.assertEqual(ring.drain(1), [(None, 10, 0)])
+            self.assertEqual(head + body[:4], b"headerbody")
+
+            sqe = ring.get_sqe()
+            self.assertRaises(BufferError, sqe.prep_readv, f.fileno(), [head, b"readonly"])
+            head += b"!"  # not pinned after failure
+            self.assertRaises(ValueError, sqe.prep_writev, f.fileno(), [])
+            sqe.prep_nop()
+            sqe = ring.get_sqe()
+            sqe.prep_read(f.fileno(), 7, offset + 10)
+            ring.submit()
+            self.assertEqual(ring.drain(2), [(None, None, 0), (None, b"trailer", 0)])
+
+    def test_file_position(self):
+        ring = self.ring
+        with tempfile.TemporaryFile() as f:
+            for data in (b"hello ", b"world"):
+                sqe = ring.get_sqe()
+                sqe.prep_write(f.fileno(), data)
+                sqe.set_flags(py_io_uring.IOSQE_IO_LINK)
+            ring.get_sqe().prep_nop()
+            ring.submit()
+            self.assertEqual([res for data, res, flags in ring.drain(3)], [6, 5, None])
+            self.assertEqual(os.lseek(f.fileno(), 0, os.SEEK_CUR), 11)
+
+    def test_argument_errors(self):
+        sqe = self.ring.get_sqe()
+        with self.assertRaises(TypeError):
+            sqe.prep_read(0)
+        with self.assertRaises(TypeError):
+            sqe.prep_read(0, 1, 0, 0)
+        with self.assertRaises(TypeError):
+            sqe.prep_read(0, 1.5)
+        with self.assertRaises(OverflowError):
+            sqe.prep_read(0, 1 << 40)
+        with self.assertRaises(TypeError):
+            sqe.prep_write(0, "str")
+        with self.assertRaises(TypeError):
+            sqe.prep_cancel(None, 0)
+        with self.assertRaises(ValueError):
+            sqe.prep_recv(0, -1)
+        with self.assertRaises(TypeError):
+            py_io_uring.AlignedBuffer(size=4096)
+        # a failed prep leaves no buffer held
+        buf = bytearray(4)
+        with self.assertRaises(TypeError):
+            sqe.prep_read_into(0, buf, "0")
+        buf.append(0)
+        sqe.prep_nop()
+        self.ring.submit()
+        self.assertEqual(self.ring.drain(1), [(None, None, 0)])
+
+    def test_cqe_seen_errors(self):
+        ring = self.ring
+        with self.assertRaises(TypeError):
+            ring.cqe_seen(bytearray(0))
+        other = IoUring()
+        other.queue_init(4, 0)
+        sqe = other.get_sqe()
+        sqe.prep_nop()
+        other.submit()
+        cqe = other.wait_cqe()
+        with self.assertRaises(ValueError):
+            ring.cqe_seen(cqe)
+        self.assertEqual(other.cq_ready(), 1)
+        other.cqe_seen(cqe)
+        self.assertEqual(other.cq_ready(), 0)
+        other.queue_exit()
 
     def tearDown(self):
         self.ring.queue_exit()
@@ -0,0 +1,87 @@
+import mmap
+import os
+import tempfile
+import unittest
+
+from py_io_uring import IoUring, BufferPool
+
+class TestBufferPool(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.pool = BufferPool(ring, 4, 4096)
+        self.file = tempfile.TemporaryFile()
+
+    def test_buffer(self):
+        pool = self.pool
+        self.assertEqual(len(pool), 4)
+        self.assertEqual(pool.size, 4096)
+        buf = pool.buffer(3)
+        self.assertEqual(len(buf), 4096)
+        self.assertFalse(buf.readonly)
+        buf[:5] = b"hello"
+        self.assertEqual(bytes(pool.buffer(3)[:5]), b"hello")
+        self.assertRaises(IndexError, pool.buffer, 4)
+
+    def test_size_page_aligned(self):
+        ring = IoUring()
+        ring.queue_init(4, 0)
+        pool = BufferPool(ring, 2, 100)
+        self.assertEqual(pool.size % os.sysconf("SC_PAGE_SIZE"), 0)
+        pool.close()
+        ring.queue_exit()
+
+    def test_write_read_fixed(self):
+        ring = self.ring
+        fd = self.file.fileno()
+        wbuf = self.pool.buffer(0)
+        wbuf[:11] = b"hello world"
+        sqe = ring.get_sqe()
+        sqe.prep_write_fixed(fd, wbuf[:11], 4096)
+        ring.submit()
+        self.assertEqual(ring.drain(1), [(None, 11, 0)])
+        self.assertEqual(os.pread(fd, 11, 4096), b"hello world")
+
+        rbuf = self.pool.buffer(1)
+        sqe = ring.get_sqe()
+        sqe.prep_read_fixed(fd, rbuf[100:200], 4096 + 6)
+        ring.submit()
+        self.assertEqual(ring.drain(1), [(None, 5, 0)])
+        self.assertEqual(bytes(rbuf[100:105]), b"world")
+
+    def test_not_pool_buffer(self):
+        sqe = self.ring.get_sqe()
+        self.assertRaises(ValueError, sqe.prep_read_fixed, 0, bytearray(10))
+        buf = memoryview(self.pool)[4000:5000]
+        self.assertRaises(ValueError, sqe.prep_read_fixed, 0, buf)
+        sqe.prep_nop()
+        self.ring.submit()
+        self.ring.drain(1)
+
+    def test_buffer_too_large(self):
+        # pages of an anonymous mapping are not allocated until touched
+        with mmap.mmap(-1, (1 << 32) + 1) as buf:
+            sqe = self.ring.get_sqe()
+            self.assertRaises(OverflowError, sqe.prep_read_fixed, 0, buf)
+            self.assertRaises(OverflowError, sqe.prep_write_fixed, 0, buf)
+        sqe.prep_nop()
+        self.ring.submit()
+        self.ring.drain(1)
+
+    def test_close_exported(self):
+        buf = self.pool.buffer(0)
+        self.assertRaises(BufferError, self.pool.close)
+        buf.release()
+        self.pool.close()
+        self.assertRaises(ValueError, memoryview, self.pool)
+
+    def tearDown(self):
+        self.file.close()
+        self.pool.close()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
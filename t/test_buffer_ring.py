@@ -0,0 +1,186 @@
+import errno
+import time
+import unittest
+from socket import *
+
+from py_io_uring import IoUring, BufferRing, ProvidedBuffer, IORING_CQE_F_MORE
+
+class TestBufferRing(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.bufring = BufferRing(ring, 1, 2, 64)
+        self.rsock, self.wsock = socketpair()
+
+    def recv(self, data=None):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        sqe.prep_recv_select(self.rsock.fileno(), self.bufring)
+        ring.submit()
+        if data is not None:
+            self.wsock.send(data)
+
+    def test_recv_select(self):
+        self.recv(b"hello world")
+        [(data, buf, flags)] = self.ring.drain(1)
+        self.assertIsInstance(buf, ProvidedBuffer)
+        self.assertEqual(len(buf), 11)
+        self.assertEqual(bytes(buf), b"hello world")
+        self.assertEqual(bytes(memoryview(buf)[6:]), b"world")
+        buf.release()
+        self.assertRaises(ValueError, bytes, buf)
+
+    def test_buffer_returned(self):
+        # only two buffers, both must come back to be selected again
+        for i in range(8):
+            self.recv(b"%d" % i)
+            [(data, buf, flags)] = self.ring.drain(1)
+            self.assertEqual(bytes(buf), b"%d" % i)
+            del buf
+
+    def test_no_buffer(self):
+        held = []
+        for i in range(2):
+            self.recv(b"x")
+            held += [r[1] for r in self.ring.drain(1)]
+        self.recv(b"y")
+        [(data, res, flags)] = self.ring.drain(1)
+        self.assertEqual(res, -errno.ENOBUFS)
+        view = memoryview(held[0])
+        self.assertRaises(BufferError, held[0].release)
+        self.assertRaises(BufferError, self.bufring.close)
+        view.release()
+        held.clear()
+        self.recv()
+        self.assertEqual(bytes(self.ring.drain(1)[0][1]), b"y")
+
+    def test_cqe_getresult(self):
+        ring = self.ring
+        self.recv(b"hello")
+        cqe = ring.wait_cqe()
+        buf = cqe.getresult()
+        self.assertIs(cqe.getresult(), buf)
+        ring.cqe_seen(cqe)
+        self.assertEqual(bytes(buf), b"hello")
+        del buf, cqe
+        # unconverted buffers are given back by cqe_seen
+        for i in range(4):
+            self.recv(b"x")
+            cqe = ring.wait_cqe()
+            ring.cqe_seen(cqe)
+        self.bufring.close()
+
+    def test_end_of_stream(self):
+        self.wsock.close()
+        self.recv()
+        self.assertEqual(self.ring.drain(1), [(None, b"", 0)])
+
+    def test_recv_multishot(self):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        sqe.prep_recv_multishot(self.rsock.fileno(), self.bufring)
+        sqe.set_data("recv")
+        ring.submit()
+        del sqe
+        for i in range(4):
+            self.wsock.send(b"%d" % i)
+            [(data, buf, flags)] = ring.drain(1)
+            self.assertEqual(data, "recv")
+            self.assertTrue(flags & IORING_CQE_F_MORE)
+            self.assertEqual(bytes(buf), b"%d" % i)
+            del buf
+
+        self.wsock.send(b"a")
+        cqe = ring.wait_cqe()
+        self.assertEqual(bytes(cqe.getresult()), b"a")
+        ring.cqe_seen(cqe)
+        self.wsock.send(b"b")
+        cqe2 = ring.wait_cqe()
+        self.assertIsNot(cqe2, cqe)
+        self.assertIs(ring.wait_cqe(), cqe2)
+        self.assertEqual(cqe2.get_data(), "recv")
+        self.assertEqual(bytes(cqe2.getresult()), b"b")
+        ring.cqe_seen(cqe2)
+        del cqe, cqe2
+
+        self.wsock.close()
+        self.assertEqual(ring.drain(1), [("recv", b"", 0)])
+
+    def test_drain_fails_mid_batch(self):
+        ring = self.ring
+        other = BufferRing(ring, 2, 1, 64)
+        rsock, wsock = socketpair()
+        with rsock, wsock:
+            self.wsock.send(b"a")
+            self.recv()
+            self.wait_ready(1)
+            wsock.send(b"b")
+            sqe = ring.get_sqe()
+            sqe.prep_recv_select(rsock.fileno(), other)
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data("after")
+            ring.submit()
+            self.wait_ready(3)
+            # the provided buffer of a closed ring can not be converted
+            other.close()
+            # completions before the failed one are returned first
+            [(data, buf, flags)] = ring.drain(3)
+            self.assertEqual(bytes(buf), b"a")
+            del buf
+            self.assertEqual(ring.cq_ready(), 2)
+            self.assertRaises(ValueError, ring.drain)
+            self.assertEqual(ring.cq_ready(), 1)
+            self.assertEqual(ring.drain(1), [("after", None, 0)])
+        held = []
+        for i in range(2):
+            self.recv(b"x")
+            held += [r[1] for r in ring.drain(1)]
+        self.assertEqual(sorted(buf.bid for buf in held), [0, 1])
+        self.recv(b"y")
+        self.assertEqual(ring.drain(1)[0][1], -errno.ENOBUFS)
+
+    def test_multishot_cqes_drained(self):
+        ring = self.ring
+        sqe = ring.get_sqe()
+        sqe.prep_recv_multishot(self.rsock.fileno(), self.bufring)
+        sqe.set_data("recv")
+        ring.submit()
+        del sqe
+        for i, data in enumerate([b"a", b"b"]):
+            self.wsock.send(data)
+            self.wait_ready(i + 1)
+        first, second = ring.wait_cqe_nr(2)
+        buf = second.getresult()
+        results = ring.drain(2)
+        self.assertEqual([bytes(r[1]) for r in results], [b"a", b"b"])
+        self.assertIs(results[1][1], buf)
+        # both were marked seen by drain, cq head must not move again
+        ring.cqe_seen(second)
+        ring.cqe_seen(first)
+        self.assertEqual(ring.cq_ready(), 0)
+        del first, second, buf, results
+
+        self.wsock.send(b"c")
+        [(data, buf, flags)] = ring.drain(1)
+        self.assertEqual(bytes(buf), b"c")
+        self.assertTrue(flags & IORING_CQE_F_MORE)
+        del buf
+        self.wsock.close()
+        self.assertEqual(ring.drain(1), [("recv", b"", 0)])
+
+    def wait_ready(self, n):
+        while self.ring.cq_ready() < n:
+            time.sleep(0.001)
+
+    def tearDown(self):
+        self.rsock.close()
+        self.wsock.close()
+        self.bufring.close()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
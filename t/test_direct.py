@@ -0,0 +1,86 @@
+import mmap
+import os
+import tempfile
+import unittest
+
+import py_io_uring
+from py_io_uring import IoUring, AlignedBuffer
+
+class TestDirect(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.TemporaryDirectory()
+        path = os.path.join(self.tmpdir.name, "direct")
+        try:
+            self.fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_DIRECT)
+            mem_align, offset_align = py_io_uring.dio_alignment(self.fd)
+            if offset_align == 0:
+                os.close(self.fd)
+                raise OSError
+        except OSError:
+            self.tmpdir.cleanup()
+            self.skipTest("file system doesn't support O_DIRECT")
+        self.align = max(mem_align, offset_align)
+        ring = IoUring()
+        ring.queue_init(8, 0)
+        self.ring = ring
+
+    def test_aligned_buffer(self):
+        buf = AlignedBuffer(1000)
+        self.assertEqual(len(buf), mmap.PAGESIZE)
+        self.assertEqual(buf.alignment, mmap.PAGESIZE)
+        view = memoryview(buf)
+        self.assertFalse(view.readonly)
+        self.assertEqual(view[:10], bytes(10))
+        self.assertEqual(len(AlignedBuffer(1000, 512)), 1024)
+        self.assertRaises(ValueError, AlignedBuffer, 4096, 3000)
+        self.assertRaises(ValueError, AlignedBuffer, 0)
+
+    def test_direct_write_read(self):
+        ring = self.ring
+        wbuf = AlignedBuffer(4 * self.align, self.align)
+        memoryview(wbuf)[:] = os.urandom(len(wbuf))
+        ring.get_sqe().prep_write(self.fd, wbuf, 0)
+        ring.submit()
+        self.assertEqual(ring.drain(1), [(None, len(wbuf), 0)])
+
+        rbuf = AlignedBuffer(2 * self.align, self.align)
+        sqe = ring.get_sqe()
+        sqe.prep_read_into(self.fd, memoryview(rbuf)[self.align:], self.align)
+        ring.get_sqe().prep_readv(self.fd, [memoryview(rbuf)[:self.align]], 3 * self.align)
+        ring.submit()
+        self.assertEqual([res for data, res, flags in ring.drain(2)], [self.align] * 2)
+        rview, wview = memoryview(rbuf), memoryview(wbuf)
+        self.assertEqual(rview[self.align:], wview[self.align:2 * self.align])
+        self.assertEqual(rview[:self.align], wview[3 * self.align:])
+
+    def test_stream_file(self):
+        data = os.urandom(8 * self.align)
+        buf = AlignedBuffer(len(data), self.align)
+        memoryview(buf)[:] = data
+        self.ring.get_sqe().prep_write(self.fd, buf, 0)
+        self.ring.submit()
+        self.assertEqual(self.ring.drain(1), [(None, len(data), 0)])
+        stream = self.ring.stream_file(self.fd, 2 * self.align, 3)
+        self.assertEqual(b"".join(bytes(chunk) for chunk in stream), data)
+
+    def test_misaligned(self):
+        buf = AlignedBuffer(2 * self.align, self.align)
+        sqe = self.ring.get_sqe()
+        self.assertRaises(ValueError, sqe.prep_read_into, self.fd, buf, 1)
+        self.assertRaises(ValueError, sqe.prep_read_into, self.fd, memoryview(buf)[1:], 0)
+        self.assertRaises(ValueError, sqe.prep_write, self.fd, memoryview(buf)[:100], 0)
+        self.assertRaises(ValueError, sqe.prep_writev, self.fd,
+                [memoryview(buf)[:self.align], memoryview(buf)[:10]], 0)
+        sqe.prep_read_into(self.fd, buf, 0)
+        self.ring.submit()
+        self.assertEqual(self.ring.drain(1), [(None, 0, 0)])
+
+    def tearDown(self):
+        os.close(self.fd)
+        self.tmpdir.cleanup()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
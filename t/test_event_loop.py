@@ -0,0 +1,211 @@
+import asyncio
+import os
+import tempfile
+import unittest
+from socket import *
+
+from py_io_uring_asyncio import IoUringEventLoop, IoUringEventLoopPolicy
+
+class EchoProtocol(asyncio.Protocol):
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def data_received(self, data):
+        self.transport.write(data)
+
+    def eof_received(self):
+        # transport is closed once echoed data is sent
+        return False
+
+
+class BufferedCollector(asyncio.BufferedProtocol):
+
+    def __init__(self, done):
+        self.buf = bytearray(7)
+        self.received = bytearray()
+        self.done = done
+
+    def get_buffer(self, sizehint):
+        return self.buf
+
+    def buffer_updated(self, nbytes):
+        self.received += self.buf[:nbytes]
+
+    def eof_received(self):
+        self.done.set_result(bytes(self.received))
+
+
+class TestEventLoop(unittest.TestCase):
+
+    def setUp(self):
+        self.loop = IoUringEventLoop()
+
+    def run_coro(self, coro):
+        return self.loop.run_until_complete(asyncio.wait_for(coro, 5))
+
+    def test_sock_methods(self):
+        async def main():
+            loop = self.loop
+            with socket(AF_INET, SOCK_STREAM) as server:
+                server.bind(('127.0.0.1', 0))
+                server.listen(5)
+                server.setblocking(False)
+                client = socket(AF_INET, SOCK_STREAM)
+                client.setblocking(False)
+                (conn, addr), _ = await asyncio.gather(
+                        loop.sock_accept(server),
+                        loop.sock_connect(client, server.getsockname()))
+                with client, conn:
+                    self.assertEqual(addr, client.getsockname())
+                    await loop.sock_sendall(client, b"x" * 100000)
+                    received = b""
+                    while len(received) < 100000:
+                        received += await loop.sock_recv(conn, 65536)
+                    self.assertEqual(received, b"x" * 100000)
+                    buf = bytearray(16)
+                    await loop.sock_sendall(conn, b"hello")
+                    self.assertEqual(await loop.sock_recv_into(client, buf), 5)
+                    self.assertEqual(buf[:5], b"hello")
+        self.run_coro(main())
+
+    def test_sock_families(self):
+        async def pair(family, addr):
+            loop = self.loop
+            with socket(family, SOCK_STREAM) as server:
+                server.bind(addr)
+                server.listen(5)
+                client = socket(family, SOCK_STREAM)
+                client.setblocking(False)
+                (conn, peer), _ = await asyncio.gather(
+                        loop.sock_accept(server),
+                        loop.sock_connect(client, server.getsockname()))
+                with client, conn:
+                    await loop.sock_sendall(client, b"ping")
+                    self.assertEqual(await loop.sock_recv(conn, 16), b"ping")
+                    return peer, client.getsockname()
+
+        with tempfile.TemporaryDirectory() as tmp:
+            peer, name = self.run_coro(pair(AF_UNIX, os.path.join(tmp, "sock")))
+            self.assertEqual(peer, name)
+        try:
+            with socket(AF_INET6, SOCK_STREAM) as s:
+                s.bind(('::1', 0))
+        except OSError:
+            self.skipTest("no ipv6 loopback")
+        peer, name = self.run_coro(pair(AF_INET6, ('::1', 0)))
+        self.assertEqual(peer, name)
+
+    def test_sock_recv_cancel(self):
+        async def main():
+            a, b = socketpair()
+            with a, b:
+                a.setblocking(False)
+                with self.assertRaises(asyncio.TimeoutError):
+                    await asyncio.wait_for(self.loop.sock_recv(a, 10), 0.01)
+                b.send(b"data")
+                return await self.loop.sock_recv(a, 10)
+        self.assertEqual(self.run_coro(main()), b"data")
+
+    def test_streams(self):
+        async def handle(reader, writer):
+            while True:
+                data = await reader.read(65536)
+                if not data:
+                    break
+                writer.write(data)
+                await writer.drain()
+            writer.close()
+
+        async def main():
+            server = await asyncio.start_server(handle, '127.0.0.1', 0)
+            addr = server.sockets[0].getsockname()
+            results = []
+            for i in range(3):
+                reader, writer = await asyncio.open_connection(*addr)
+                payload = (b"%d" % i) * 500000
+                writer.write(payload)
+                writer.write_eof()
+                results.append(await reader.read() == payload)
+                writer.close()
+                await writer.wait_closed()
+            server.close()
+            await server.wait_closed()
+            return results
+        self.assertEqual(self.run_coro(main()), [True] * 3)
+
+    def test_create_server(self):
+        async def main():
+            loop = self.loop
+            server = await loop.create_server(EchoProtocol, '127.0.0.1', 0)
+            addr = server.sockets[0].getsockname()
+            done = loop.create_future()
+            transport, protocol = await loop.create_connection(
+                    lambda: BufferedCollector(done), *addr)
+            transport.write(b"hello buffered world")
+            transport.write_eof()
+            data = await done
+            transport.close()
+            server.close()
+            await server.wait_closed()
+            return data
+        self.assertEqual(self.run_coro(main()), b"hello buffered world")
+
+    def test_pause_reading(self):
+        async def main():
+            loop = self.loop
+            a, b = socketpair()
+            received = []
+            class Collector(asyncio.Protocol):
+                def data_received(self, data):
+                    received.append(data)
+            transport, _ = await loop.connect_accepted_socket(Collector, a)
+            transport.pause_reading()
+            self.assertFalse(transport.is_reading())
+            b.send(b"paused")
+            await asyncio.sleep(0.05)
+            self.assertEqual(received, [])
+            transport.resume_reading()
+            await asyncio.sleep(0.05)
+            self.assertEqual(received, [b"paused"])
+            transport.abort()
+            b.close()
+        self.run_coro(main())
+
+    def test_accept_error(self):
+        async def main():
+            loop = self.loop
+            errors = []
+            loop.set_exception_handler(lambda loop, context: errors.append(context))
+            server = await loop.create_server(EchoProtocol, '127.0.0.1', 0)
+            fd = server.sockets[0].fileno()
+            loop._acceptors[fd].retry_delay = 0.01
+            # a listening socket shut down fails every accept with EINVAL
+            with socket(fileno=os.dup(fd)) as sock:
+                sock.shutdown(SHUT_RDWR)
+            await asyncio.sleep(0.1)
+            server.close()
+            await server.wait_closed()
+            return errors
+        errors = self.run_coro(main())
+        self.assertTrue(errors)
+        # reported and retried after a delay instead of spinning
+        self.assertLess(len(errors), 20)
+        self.assertEqual(errors[0]['message'], 'socket.accept() failed')
+        self.assertIsInstance(errors[0]['exception'], OSError)
+
+    def test_policy(self):
+        async def main():
+            return type(asyncio.get_running_loop())
+        asyncio.set_event_loop_policy(IoUringEventLoopPolicy())
+        try:
+            self.assertIs(asyncio.run(main()), IoUringEventLoop)
+        finally:
+            asyncio.set_event_loop_policy(None)
+
+    def tearDown(self):
+        self.loop.close()
+
+
+if __name__ == '__main__':
+    unittest.main()
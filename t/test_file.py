@@ -0,0 +1,138 @@
+import errno
+import os
+import stat
+import tempfile
+import unittest
+
+import py_io_uring
+from py_io_uring import IoUring
+
+class TestFile(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.tmpdir = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.tmpdir.name, "data")
+
+    def submit_one(self):
+        self.ring.submit()
+        (data, res, flags), = self.ring.drain(1)
+        return res
+
+    def test_open_statx_read_close(self):
+        ring = self.ring
+        with open(self.path, "wb") as f:
+            f.write(b"hello world")
+
+        ring.get_sqe().prep_openat(self.path, os.O_RDONLY)
+        fd = self.submit_one()
+        self.assertGreaterEqual(fd, 0)
+
+        ring.get_sqe().prep_statx(self.path)
+        st = self.submit_one()
+        self.assertIsInstance(st, py_io_uring.StatxResult)
+        expected = os.stat(self.path)
+        self.assertEqual(st.size, 11)
+        self.assertEqual(st.ino, expected.st_ino)
+        self.assertEqual(st.mtime_ns, expected.st_mtime_ns)
+        self.assertTrue(stat.S_ISREG(st.mode))
+
+        # stat the opened fd itself
+        ring.get_sqe().prep_statx("", py_io_uring.AT_EMPTY_PATH,
+                py_io_uring.STATX_BASIC_STATS, fd)
+        st = self.submit_one()
+        self.assertEqual(st.ino, expected.st_ino)
+
+        ring.get_sqe().prep_read(fd, 5)
+        self.assertEqual(self.submit_one(), b"hello")
+        ring.get_sqe().prep_close(fd)
+        self.assertEqual(self.submit_one(), 0)
+        self.assertRaises(OSError, os.fstat, fd)
+
+    def test_openat_error(self):
+        self.ring.get_sqe().prep_openat(os.path.join(self.path, "missing"), os.O_RDONLY)
+        self.assertEqual(self.submit_one(), -errno.ENOENT)
+
+    def test_openat_dir_fd(self):
+        ring = self.ring
+        dir_fd = os.open(self.tmpdir.name, os.O_RDONLY | os.O_DIRECTORY)
+        try:
+            ring.get_sqe().prep_openat("created", os.O_WRONLY | os.O_CREAT, 0o600, dir_fd)
+            os.close(self.submit_one())
+            st = os.stat(os.path.join(self.tmpdir.name, "created"))
+            self.assertEqual(stat.S_IMODE(st.st_mode), 0o600 & ~self.umask())
+        finally:
+            os.close(dir_fd)
+
+    def umask(self):
+        mask = os.umask(0)
+        os.umask(mask)
+        return mask
+
+    def test_write_sync_rename_unlink(self):
+        ring = self.ring
+        fd = os.open(self.path, os.O_RDWR | os.O_CREAT)
+        try:
+            ring.get_sqe().prep_fallocate(fd, 0, 0, 1 << 20)
+            self.assertEqual(self.submit_one(), 0)
+            self.assertEqual(os.fstat(fd).st_size, 1 << 20)
+            ring.get_sqe().prep_fallocate(fd, py_io_uring.FALLOC_FL_KEEP_SIZE, 0, 2 << 20)
+            self.assertEqual(self.submit_one(), 0)
+            self.assertEqual(os.fstat(fd).st_size, 1 << 20)
+
+            ring.get_sqe().prep_write(fd, b"payload")
+            ring.get_sqe().prep_sync_file_range(fd, 0, 7,
+                    py_io_uring.SYNC_FILE_RANGE_WAIT_BEFORE |
+                    py_io_uring.SYNC_FILE_RANGE_WRITE |
+                    py_io_uring.SYNC_FILE_RANGE_WAIT_AFTER)
+            ring.get_sqe().prep_fsync(fd, py_io_uring.IORING_FSYNC_DATASYNC)
+            ring.submit()
+            self.assertEqual([res for data, res, flags in ring.drain(3)], [7, 0, 0])
+        finally:
+            os.close(fd)
+
+        renamed = self.path + ".renamed"
+        ring.get_sqe().prep_renameat(self.path, renamed)
+        self.assertEqual(self.submit_one(), 0)
+        self.assertFalse(os.path.exists(self.path))
+        with open(renamed, "rb") as f:
+            self.assertEqual(f.read(7), b"payload")
+
+        open(self.path, "wb").close()
+        ring.get_sqe().prep_renameat(self.path, renamed, py_io_uring.RENAME_NOREPLACE)
+        self.assertEqual(self.submit_one(), -errno.EEXIST)
+
+        ring.get_sqe().prep_unlinkat(renamed)
+        self.assertEqual(self.submit_one(), 0)
+        self.assertFalse(os.path.exists(renamed))
+
+        subdir = os.path.join(self.tmpdir.name, "subdir")
+        os.mkdir(subdir)
+        ring.get_sqe().prep_unlinkat(subdir, py_io_uring.AT_REMOVEDIR)
+        self.assertEqual(self.submit_one(), 0)
+        self.assertFalse(os.path.exists(subdir))
+
+    def test_close_direct(self):
+        ring = self.ring
+        fd = os.open(self.path, os.O_RDWR | os.O_CREAT)
+        try:
+            ring.register_files([fd])
+            ring.get_sqe().prep_close_direct(0)
+            self.assertEqual(self.submit_one(), 0)
+            sqe = ring.get_sqe()
+            sqe.prep_write(0, b"x")
+            sqe.set_fixed_file()
+            self.assertEqual(self.submit_one(), -errno.EBADF)
+            ring.unregister_files()
+        finally:
+            os.close(fd)
+
+    def tearDown(self):
+        self.ring.queue_exit()
+        self.tmpdir.cleanup()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,4 +1,5 @@
 import unittest
+import py_io_uring
 from py_io_uring import IoUring
 
 class TestInit(unittest.TestCase):
@@ -12,6 +13,45 @@ class TestInit(unittest.TestCase):
         ring = IoUring()
         self.assertRaises(OSError, ring.queue_init, -1, 0)
 
+    def test_queue_init_params(self):
+        ring = IoUring()
+        self.assertEqual(ring.features(), 0)
+        ring.queue_init_params(4, cq_entries=64)
+        self.assertTrue(ring.features() & py_io_uring.IORING_FEAT_NODROP)
+        # cq larger than sq, more operations than sq entries can be in flight
+        for i in range(3):
+            for j in range(4):
+                ring.get_sqe().prep_nop()
+            ring.submit()
+        self.assertEqual(ring.cq_ready(), 12)
+        self.assertEqual(len(ring.drain()), 12)
+        ring.queue_exit()
+
+    def test_queue_init_params_exception(self):
+        ring = IoUring()
+        self.assertRaises(TypeError, ring.queue_init_params, 4, 0, 0)
+        self.assertRaises(OSError, ring.queue_init_params, 4, wq_fd=1000)
+
+    def test_sqpoll(self):
+        ring = IoUring()
+        ring.queue_init_params(4, py_io_uring.IORING_SETUP_SQPOLL, sq_thread_idle=10)
+        for i in range(8):
+            ring.get_sqe().prep_nop()
+            ring.submit()
+            self.assertEqual(ring.drain(1), [(None, None, 0)])
+        ring.queue_exit()
+
+    @unittest.skipUnless(hasattr(py_io_uring, "IORING_SETUP_DEFER_TASKRUN"),
+            "IORING_SETUP_DEFER_TASKRUN not supported")
+    def test_defer_taskrun(self):
+        ring = IoUring()
+        ring.queue_init_params(4, py_io_uring.IORING_SETUP_SINGLE_ISSUER
+                | py_io_uring.IORING_SETUP_DEFER_TASKRUN)
+        ring.get_sqe().prep_nop()
+        ring.submit()
+        self.assertEqual(ring.drain(1), [(None, None, 0)])
+        ring.queue_exit()
+
 
 if __name__ ==  '__main__':
     unittest.main()
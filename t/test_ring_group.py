@@ -0,0 +1,99 @@
+import os
+import threading
+import unittest
+from socket import *
+
+from py_io_uring import IoUring, RingGroup
+
+class TestRingGroup(unittest.TestCase):
+
+    def setUp(self):
+        self.group = RingGroup(2, 8)
+
+    def test_send_msg(self):
+        a, b = self.group
+        self.assertEqual(len(self.group), 2)
+        sqe = a.get_sqe()
+        sqe.prep_send_msg(b, "hello", 7)
+        a.submit()
+        self.assertEqual(a.drain(1), [(None, 0, 0)])
+        self.assertEqual(b.drain(1), [("hello", 7, 0)])
+        # to itself, without res
+        sqe = a.get_sqe()
+        sqe.prep_send_msg(a, ["self"])
+        a.submit()
+        self.assertEqual(sorted(a.drain(2), key=repr), [(None, 0, 0), (["self"], 0, 0)])
+
+    def test_reprep(self):
+        a, b = self.group
+        sqe = a.get_sqe()
+        sqe.prep_send_msg(b, "dropped")
+        sqe.prep_nop()
+        a.submit()
+        self.assertEqual(a.drain(1), [(None, None, 0)])
+        sqe = b.get_sqe()
+        sqe.prep_nop()
+        b.submit()
+        self.assertEqual(b.drain(1), [(None, None, 0)])
+
+    def test_workers(self):
+        # ring 0 accepts, connections are handed to worker rings by message
+        group = RingGroup(3, 8)
+        acceptor, workers = group[0], [group[1], group[2]]
+        results = [[] for w in workers]
+
+        def work(ring, out):
+            while True:
+                ring.wait_cqe()
+                for fd, res, flags in ring.drain():
+                    if fd is None:
+                        return
+                    with socket(fileno=fd) as conn:
+                        out.append(conn.recv(16))
+
+        threads = [threading.Thread(target=work, args=(w, r)) for w, r in zip(workers, results)]
+        for t in threads:
+            t.start()
+        try:
+            with socket(AF_INET, SOCK_STREAM) as server:
+                server.bind(('127.0.0.1', 0))
+                server.listen(8)
+                for i in range(4):
+                    with create_connection(server.getsockname()) as c:
+                        c.send(b"conn %d" % i)
+                        sqe = acceptor.get_sqe()
+                        sqe.prep_accept(server.fileno())
+                        acceptor.submit()
+                        [(_, fd, flags)] = acceptor.drain(1)
+                        sqe = acceptor.get_sqe()
+                        sqe.prep_send_msg(workers[i % 2], fd)
+                        acceptor.submit()
+                        self.assertEqual(acceptor.drain(1), [(None, 0, 0)])
+            for w in workers:
+                sqe = acceptor.get_sqe()
+                sqe.prep_send_msg(w, None)
+            acceptor.submit()
+            acceptor.drain(2)
+        finally:
+            for t in threads:
+                t.join(5)
+            group.close()
+        self.assertEqual(results, [[b"conn 0", b"conn 2"], [b"conn 1", b"conn 3"]])
+
+    def test_closed_target(self):
+        a, b = self.group
+        b.queue_exit()
+        with self.assertRaises(ValueError):
+            a.get_sqe().prep_send_msg(b, None)
+        with self.assertRaises(TypeError):
+            a.get_sqe().prep_send_msg(None, None)
+        with self.assertRaises(ValueError):
+            RingGroup(0, 8)
+
+    def tearDown(self):
+        self.group.close()
+        self.group.close()
+
+
+if __name__ == '__main__':
+    unittest.main()
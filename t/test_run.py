@@ -0,0 +1,168 @@
+import errno
+import sys
+import time
+import unittest
+from socket import *
+
+from py_io_uring import IoUring, BufferRing
+
+class TestRun(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.calls = []
+
+    def record(self, *args):
+        self.calls.append(args)
+
+    def test_callbacks(self):
+        ring = self.ring
+        a, b = socketpair()
+        with a, b:
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_callback(self.record)
+            sqe = ring.get_sqe()
+            sqe.prep_recv(a.fileno(), 16)
+            sqe.set_callback(self.record, "recv", 1)
+            sqe = ring.get_sqe()
+            sqe.prep_recv(-1, 16)
+            sqe.set_callback(self.record, "bad")
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data("plain")
+            b.send(b"hello")
+            results = []
+            while len(self.calls) < 3:
+                results.extend(ring.run(32, 1))
+            self.assertEqual(results, [("plain", None, 0)])
+            self.assertEqual(sorted(self.calls, key=repr), sorted([
+                (None,), (b"hello", "recv", 1), (-errno.EBADF, "bad")], key=repr))
+            self.assertEqual(ring.cq_ready(), 0)
+
+    def test_max_events(self):
+        ring = self.ring
+        for i in range(10):
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_callback(self.record, i)
+        ring.submit()
+        self.assertEqual(ring.run(4, 0), [])
+        self.assertEqual(len(self.calls), 4)
+        ring.run(100, 0)
+        self.assertEqual(sorted(self.calls), [(None, i) for i in range(10)])
+
+    def test_many_args(self):
+        sqe = self.ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_callback(self.record, *range(20))
+        self.ring.run(1)
+        self.assertEqual(self.calls, [(None,) + tuple(range(20))])
+
+    def test_chained(self):
+        # ops prepared by callbacks are submitted before run returns
+        ring = self.ring
+        def again(res, n):
+            self.calls.append(n)
+            if n < 5:
+                sqe = ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_callback(again, n + 1)
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_callback(again, 0)
+        for i in range(6):
+            ring.run(8, 1)
+        self.assertEqual(self.calls, list(range(6)))
+        self.assertEqual(ring.sq_ready(), 0)
+
+    def test_timeout(self):
+        start = time.monotonic()
+        self.assertEqual(self.ring.run(8, 0.05), [])
+        self.assertGreaterEqual(time.monotonic() - start, 0.04)
+        self.assertEqual(self.ring.run(8, 0), [])
+        with self.assertRaises(ValueError):
+            self.ring.run(8, -1)
+
+    def test_callback_error(self):
+        ring = self.ring
+        def fail(res, msg):
+            raise RuntimeError(msg)
+        for msg in ("first", "second"):
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_callback(fail, msg)
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_callback(self.record, "after")
+        ring.submit()
+        while ring.cq_ready() < 3:
+            time.sleep(0.001)
+        unraisable = []
+        hook, sys.unraisablehook = sys.unraisablehook, unraisable.append
+        try:
+            with self.assertRaisesRegex(RuntimeError, "first"):
+                ring.run(8)
+        finally:
+            sys.unraisablehook = hook
+        self.assertEqual(str(unraisable[0].exc_value), "second")
+        # the rest of the batch is not lost
+        self.assertEqual(self.calls, [(None, "after")])
+        self.assertEqual(ring.cq_ready(), 0)
+        with self.assertRaises(TypeError):
+            ring.get_sqe().set_callback(None)
+
+    def test_convert_error(self):
+        ring = self.ring
+        bufring = BufferRing(ring, 1, 1, 64)
+        closed = BufferRing(ring, 2, 1, 64)
+        a, b = socketpair()
+        c, d = socketpair()
+        with a, b, c, d:
+            b.send(b"before")
+            d.send(b"lost")
+            sqe = ring.get_sqe()
+            sqe.prep_recv_select(a.fileno(), bufring)
+            sqe.set_callback(lambda buf: self.record(bytes(buf)))
+            sqe = ring.get_sqe()
+            sqe.prep_recv_select(c.fileno(), closed)
+            sqe.set_callback(self.record)
+            sqe = ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_callback(self.record, "after")
+            ring.submit()
+            while ring.cq_ready() < 3:
+                time.sleep(0.001)
+            # the provided buffer of a closed ring can not be converted
+            closed.close()
+            # callbacks before the failed completion are called first
+            self.assertEqual(ring.run(32, 0), [])
+            self.assertEqual(self.calls, [(b"before",)])
+            self.assertEqual(ring.cq_ready(), 2)
+            self.assertRaises(ValueError, ring.run, 32, 0)
+            self.assertEqual(ring.cq_ready(), 1)
+            ring.run(32, 0)
+            self.assertEqual(self.calls[1:], [(None, "after")])
+            # the only buffer was given back once, it can not be selected twice
+            self.calls.clear()
+            b.send(b"x")
+            for i in range(2):
+                sqe = ring.get_sqe()
+                sqe.prep_recv_select(a.fileno(), bufring)
+                sqe.set_callback(self.record)
+                ring.submit()
+                while len(self.calls) <= i:
+                    ring.run(32, 1)
+            self.assertEqual(bytes(self.calls[0][0]), b"x")
+            self.assertEqual(self.calls[1], (-errno.ENOBUFS,))
+            self.calls.clear()
+        bufring.close()
+
+    def tearDown(self):
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,7 +1,11 @@
+import errno
+import os
+import tempfile
 import unittest
 from socket import *
 
-from py_io_uring import IoUring
+import py_io_uring
+from py_io_uring import IoUring, IORING_CQE_F_MORE
 
 class TestSocket(unittest.TestCase):
 
@@ -101,10 +105,213 @@ class TestSocket(unittest.TestCase):
                 sqe.set_data(1)
 
                 ring.submit()
-                print("start wait")
-                cqes = ring.wait_cqes(2)
-                print("end wait")
+                csock.send(b"hello world")
+                with self.connect_server():
+                    cqes = ring.wait_cqes(2)
+                    results = {cqe.get_data(): cqe.getresult() for cqe in cqes}
+                    for cqe in cqes:
+                        ring.cqe_seen(cqe)
+                    self.assertEqual(results[2], b"hello world")
+                    socket(fileno=results[1]).close()
+
+    def test_drain(self):
+        ring = self.ring
+        with self.connect_server() as ssock:
+            csock, addr = self.server.accept()
+            with csock:
+                sqe = ring.get_sqe()
+                sqe.prep_recv(ssock.fileno(), 1024)
+                sqe.set_data("recv")
+                ring.submit()
+                csock.send(b"hello world")
+                self.assertEqual(ring.drain(1), [("recv", b"hello world", 0)])
+
+    def test_prep_recv_into(self):
+        ring = self.ring
+        buf = bytearray(16)
+        with self.connect_server() as ssock:
+            csock, addr = self.server.accept()
+            with csock:
+                sqe = ring.get_sqe()
+                sqe.prep_recv_into(ssock.fileno(), memoryview(buf)[4:])
+                ring.submit()
+                csock.send(b"hello world")
+                self.assertEqual(ring.drain(1), [(None, 11, 0)])
+                self.assertEqual(bytes(buf[4:15]), b"hello world")
+
+    def test_prep_recv_into_readonly(self):
+        sqe = self.ring.get_sqe()
+        self.assertRaises(TypeError, sqe.prep_recv_into, 0, b"readonly")
+        sqe.prep_nop()
+        self.ring.submit()
+        self.ring.drain(1)
+
+    def test_register_files(self):
+        ring = self.ring
+        with self.connect_server() as ssock:
+            csock, addr = self.server.accept()
+            with csock:
+                ring.register_files([-1, ssock.fileno()])
+                buf = bytearray(16)
+                sqe = ring.get_sqe()
+                sqe.prep_recv_into(1, buf)
+                sqe.set_fixed_file()
+                ring.submit()
+                csock.send(b"hello world")
+                self.assertEqual(ring.drain(1), [(None, 11, 0)])
+                self.assertEqual(bytes(buf[:11]), b"hello world")
+
+                self.assertEqual(ring.register_files_update(1, [-1]), 1)
+                sqe = ring.get_sqe()
+                sqe.prep_recv_into(1, buf)
+                sqe.set_fixed_file()
+                ring.submit()
+                self.assertEqual(ring.drain(1)[0][1], -errno.EBADF)
+                ring.unregister_files()
+
+    def test_prep_accept_direct(self):
+        ring = self.ring
+        ring.register_files(4)
+        sqe = ring.get_sqe()
+        sqe.prep_accept_direct(self.server.fileno(), 2)
+        sqe.set_data("slot")
+        sqe = ring.get_sqe()
+        sqe.prep_accept_direct(self.server.fileno())
+        sqe.set_data("alloc")
+        ring.submit()
+        with self.connect_server() as c1, self.connect_server() as c2:
+            results = dict((data, res) for data, res, flags in ring.drain(2))
+            self.assertEqual(results["slot"], 0)
+            self.assertIn(results["alloc"], (0, 1, 3))
+
+            for index in (2, results["alloc"]):
+                sqe = ring.get_sqe()
+                sqe.prep_send(index, b"world")
+                sqe.set_fixed_file()
+            ring.submit()
+            self.assertEqual([res for data, res, flags in ring.drain(2)], [5, 5])
+            self.assertEqual(c1.recv(16) + c2.recv(16), b"worldworld")
+
+    def test_prep_multishot_accept(self):
+        ring = self.ring
+        accept = ring.get_sqe()
+        accept.prep_multishot_accept(self.server.fileno())
+        accept.set_data("accept")
+        ring.submit()
+        clients = [self.connect_server() for i in range(3)]
+        results = []
+        while len(results) < 3:
+            results.extend(ring.drain(1))
+        for data, fd, flags in results:
+            self.assertEqual(data, "accept")
+            self.assertTrue(flags & IORING_CQE_F_MORE)
+            socket(fileno=fd).close()
+
+        sqe = ring.get_sqe()
+        sqe.prep_cancel(accept, 0)
+        sqe.set_data("cancel")
+        ring.submit()
+        results = dict((data, (res, flags)) for data, res, flags in ring.drain(2))
+        self.assertEqual(results["cancel"], (0, 0))
+        self.assertEqual(results["accept"], (-errno.ECANCELED, 0))
+        for c in clients:
+            c.close()
+
+    def test_recv_deadline(self):
+        ring = self.ring
+        buf = bytearray(16)
+        with self.connect_server() as ssock:
+            csock, addr = self.server.accept()
+            with csock:
+                sqe = ring.get_sqe()
+                sqe.prep_recv_into(ssock.fileno(), buf)
+                sqe.set_flags(py_io_uring.IOSQE_IO_LINK)
+                sqe.set_data("recv")
+                sqe = ring.get_sqe()
+                sqe.prep_link_timeout(0.01)
+                sqe.set_data("deadline")
+                ring.submit()
+                results = dict((data, res) for data, res, flags in ring.drain(2))
+                self.assertEqual(results, {"recv": -errno.ECANCELED, "deadline": -errno.ETIME})
+
+    def accept_connect(self, server, addr, mode):
+        ring = self.ring
+        with socket(server.family, SOCK_STREAM, 0) as csock:
+            sqe = ring.get_sqe()
+            sqe.prep_accept(server.fileno(), 0, mode)
+            sqe.set_data("accept")
+            accept = sqe
+            sqe = ring.get_sqe()
+            sqe.prep_connect(csock.fileno(), addr)
+            sqe.set_data("connect")
+            ring.submit()
+            results = {}
+            for i in range(2):
+                cqe = ring.wait_cqe()
+                self.assertGreaterEqual(cqe.res(), 0)
+                results[cqe.get_data()] = cqe.getresult()
+                if cqe.get_data() == "accept" and mode == py_io_uring.ACCEPT_ADDR:
+                    results["addr"] = accept.convert_address()
+                ring.cqe_seen(cqe)
+            self.assertEqual(results["connect"], 0)
+            if mode == py_io_uring.ACCEPT_RESULT_ADDR:
+                fd, peer = results["accept"]
+            else:
+                fd, peer = results["accept"], results.get("addr")
+            with socket(fileno=fd) as ssock:
+                self.comunicate(ssock, csock)
+                if mode != py_io_uring.ACCEPT_NO_ADDR:
+                    self.assertEqual(peer, csock.getsockname())
+            return peer
+
+    def test_accept_modes(self):
+        for mode in (py_io_uring.ACCEPT_ADDR, py_io_uring.ACCEPT_RESULT_ADDR):
+            peer = self.accept_connect(self.server, self.target_addr, mode)
+            self.assertEqual(peer[0], '127.0.0.1')
+        self.assertIsNone(self.accept_connect(self.server, self.target_addr,
+                py_io_uring.ACCEPT_NO_ADDR))
+        with self.assertRaises(ValueError):
+            self.ring.get_sqe().prep_accept(self.server.fileno(), 0, 0)
+
+    def test_ipv6(self):
+        try:
+            server = socket(AF_INET6, SOCK_STREAM, 0)
+            server.bind(('::1', 0))
+        except OSError:
+            self.skipTest("no ipv6 loopback")
+        with server:
+            server.listen(5)
+            for mode in (py_io_uring.ACCEPT_ADDR, py_io_uring.ACCEPT_RESULT_ADDR):
+                peer = self.accept_connect(server, server.getsockname(), mode)
+                self.assertEqual(len(peer), 4)
+                self.assertEqual(peer[0], '::1')
+            # (host, port) is enough for ipv6 too
+            self.accept_connect(server, server.getsockname()[:2], py_io_uring.ACCEPT_NO_ADDR)
+
+    def test_unix(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "sock")
+            with socket(AF_UNIX, SOCK_STREAM, 0) as server:
+                server.bind(path)
+                server.listen(5)
+                # client sockets are unnamed
+                self.assertEqual(self.accept_connect(server, path,
+                        py_io_uring.ACCEPT_RESULT_ADDR), '')
+                self.accept_connect(server, path.encode(), py_io_uring.ACCEPT_ADDR)
+        name = b"\0py_io_uring-%d" % os.getpid()
+        with socket(AF_UNIX, SOCK_STREAM, 0) as server:
+            server.bind(name)
+            server.listen(5)
+            self.accept_connect(server, name, py_io_uring.ACCEPT_ADDR)
 
+    def test_connect_bad_address(self):
+        sqe = self.ring.get_sqe()
+        with self.assertRaises(ValueError):
+            sqe.prep_connect(0, ('localhost', 80))
+        with self.assertRaises(OSError):
+            sqe.prep_connect(0, "x" * 200)
+        with self.assertRaises(OverflowError):
+            sqe.prep_connect(0, ('127.0.0.1', 70000))
 
     def tearDown(self):
         self.server.close()
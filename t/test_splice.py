@@ -0,0 +1,147 @@
+import errno
+import os
+import tempfile
+import threading
+import unittest
+from socket import *
+
+import py_io_uring
+from py_io_uring import IoUring, Proxy
+
+class TestSplice(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+
+    def run_proxy(self, proxy):
+        ring = self.ring
+        while True:
+            ring.submit()
+            for data, res, flags in ring.drain(1):
+                if data is proxy:
+                    return res
+
+    def test_splice_tee(self):
+        ring = self.ring
+        r1, w1 = os.pipe()
+        r2, w2 = os.pipe()
+        try:
+            with tempfile.TemporaryFile() as f:
+                f.write(b"spliced data")
+                f.flush()
+                sqe = ring.get_sqe()
+                sqe.prep_splice(f.fileno(), 0, w1, -1, 100)
+                # a short splice would break IOSQE_IO_LINK
+                sqe.set_flags(py_io_uring.IOSQE_IO_HARDLINK)
+                ring.get_sqe().prep_tee(r1, w2, 100)
+                ring.submit()
+                self.assertEqual([res for data, res, flags in ring.drain(2)], [12, 12])
+                self.assertEqual(os.read(r1, 100), b"spliced data")
+                self.assertEqual(os.read(r2, 100), b"spliced data")
+
+                ring.get_sqe().prep_splice(f.fileno(), 0, f.fileno(), -1, 100)
+                ring.submit()
+                self.assertEqual(ring.drain(1), [(None, -errno.EINVAL, 0)])
+        finally:
+            for fd in (r1, w1, r2, w2):
+                os.close(fd)
+
+    def test_proxy(self):
+        a, b = socketpair()
+        c, d = socketpair()
+        payload = os.urandom(1 << 20)
+        received = bytearray()
+        def peer():
+            b.sendall(payload)
+            b.shutdown(SHUT_WR)
+        def sink():
+            while data := d.recv(65536):
+                received.extend(data)
+        threads = [threading.Thread(target=peer), threading.Thread(target=sink)]
+        with a, b, c, d:
+            proxy = Proxy(self.ring, a.fileno(), c.fileno(), 4096)
+            self.assertEqual(proxy.pipe_size, 4096)
+            for t in threads:
+                t.start()
+            self.assertEqual(self.run_proxy(proxy), len(payload))
+            self.assertTrue(proxy.done)
+            self.assertEqual(proxy.transferred, len(payload))
+            c.shutdown(SHUT_WR)
+            for t in threads:
+                t.join()
+        self.assertEqual(received, payload)
+
+    def test_proxy_nonblocking(self):
+        a, b = socketpair()
+        c, d = socketpair()
+        a.setblocking(False)
+        c.setblocking(False)
+        # small buffers to fill dst before the sink starts reading
+        c.setsockopt(SOL_SOCKET, SO_SNDBUF, 4096)
+        payload = os.urandom(1 << 20)
+        received = bytearray()
+        def peer():
+            for i in range(0, len(payload), 65536):
+                b.sendall(payload[i:i + 65536])
+            b.shutdown(SHUT_WR)
+        def sink():
+            while data := d.recv(65536):
+                received.extend(data)
+        threads = [threading.Thread(target=peer), threading.Thread(target=sink)]
+        with a, b, c, d:
+            proxy = Proxy(self.ring, a.fileno(), c.fileno())
+            for t in threads:
+                t.start()
+            self.assertEqual(self.run_proxy(proxy), len(payload))
+            c.shutdown(SHUT_WR)
+            for t in threads:
+                t.join()
+        self.assertEqual(received, payload)
+
+    def test_proxy_file(self):
+        c, d = socketpair()
+        with c, d, tempfile.TemporaryFile() as f:
+            f.write(b"static content" * 1000)
+            f.flush()
+            f.seek(0)
+            proxy = Proxy(self.ring, f.fileno(), c.fileno())
+            self.assertEqual(self.run_proxy(proxy), 14000)
+            c.close()
+            received = b""
+            while data := d.recv(65536):
+                received += data
+            self.assertEqual(received, b"static content" * 1000)
+
+    def test_proxy_error(self):
+        a, b = socketpair()
+        with a, b:
+            proxy = Proxy(self.ring, a.fileno(), -1)
+            b.send(b"lost")
+            self.assertEqual(self.run_proxy(proxy), -errno.EBADF)
+            self.assertTrue(proxy.done)
+        self.assertRaises(ValueError, Proxy, self.ring, 0, 1, 0)
+
+    def test_proxy_mixed(self):
+        # regular completions are still reported while a proxy runs
+        a, b = socketpair()
+        c, d = socketpair()
+        with a, b, c, d:
+            proxy = Proxy(self.ring, a.fileno(), c.fileno())
+            sqe = self.ring.get_sqe()
+            sqe.prep_nop()
+            sqe.set_data("nop")
+            self.ring.submit()
+            self.assertEqual(self.ring.drain(1), [("nop", None, 0)])
+            b.sendall(b"through proxy")
+            b.shutdown(SHUT_WR)
+            self.assertEqual(self.run_proxy(proxy), 13)
+            self.assertEqual(d.recv(100), b"through proxy")
+
+    def tearDown(self):
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
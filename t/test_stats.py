@@ -0,0 +1,97 @@
+import errno
+import time
+import unittest
+from socket import *
+
+from py_io_uring import IoUring, IORING_OP_NOP, IORING_OP_RECV
+
+class TestStats(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(4, 0)
+        self.ring = ring
+
+    def test_disabled(self):
+        self.ring.get_sqe().prep_nop()
+        self.ring.submit()
+        self.assertEqual(self.ring.stats(), {"enabled": False, "inflight": 1, "cq_overflow": 0})
+        self.ring.drain(1)
+        self.assertEqual(self.ring.stats()["inflight"], 0)
+
+    def test_counters(self):
+        ring = self.ring
+        ring.enable_stats()
+        for i in range(10):
+            ring.get_sqe().prep_nop()
+            ring.submit()
+            ring.drain(1)
+        ring.get_sqe().prep_recv(-1, 16)
+        ring.submit()
+        cqe = ring.wait_cqe()
+        ring.cqe_seen(cqe)
+        for i in range(4):
+            ring.get_sqe().prep_nop()
+        with self.assertRaises(OSError):
+            ring.get_sqe()
+        ring.submit()
+        ring.drain(4)
+        stats = ring.stats()
+        self.assertTrue(stats["enabled"])
+        self.assertEqual(stats["submitted"], {IORING_OP_NOP: 14, IORING_OP_RECV: 1})
+        self.assertEqual(stats["completed"], {IORING_OP_NOP: 14, IORING_OP_RECV: 1})
+        self.assertEqual(stats["errors"], {errno.EBADF: 1})
+        self.assertEqual(stats["sq_full"], 1)
+        self.assertGreaterEqual(stats["enter_calls"], 12)
+        self.assertEqual(stats["inflight"], 0)
+        # restart from zero
+        ring.enable_stats()
+        self.assertEqual(ring.stats()["submitted"], {})
+        ring.enable_stats(False)
+        self.assertFalse(ring.stats()["enabled"])
+
+    def test_latency(self):
+        ring = self.ring
+        ring.enable_stats()
+        a, b = socketpair()
+        with a, b:
+            for i in range(3):
+                ring.get_sqe().prep_recv(a.fileno(), 16)
+                ring.submit()
+                time.sleep(0.01)
+                b.send(b"x")
+                ring.drain(1)
+            ring.get_sqe().prep_nop()
+            ring.submit()
+            ring.drain(1)
+        latency = ring.stats()["latency"]
+        self.assertEqual(set(latency), {IORING_OP_NOP, IORING_OP_RECV})
+        recv = latency[IORING_OP_RECV]
+        self.assertEqual(recv["count"], 3)
+        self.assertGreaterEqual(recv["min_ns"], 10000000)
+        self.assertLessEqual(recv["min_ns"], recv["p50_ns"])
+        self.assertLessEqual(recv["p50_ns"], recv["p999_ns"])
+        self.assertEqual(recv["p999_ns"], recv["max_ns"])
+        self.assertEqual(sum(n for upper, n in recv["buckets"]), 3)
+        # a bucket is within 12.5% of the values it holds
+        upper = recv["buckets"][-1][0]
+        self.assertTrue(recv["max_ns"] <= upper <= recv["max_ns"] * 1.125)
+        self.assertLess(latency[IORING_OP_NOP]["max_ns"], recv["min_ns"])
+
+    def test_before_enable(self):
+        # operations submitted before enable_stats have no latency
+        ring = self.ring
+        ring.get_sqe().prep_nop()
+        ring.submit()
+        ring.enable_stats()
+        ring.drain(1)
+        stats = ring.stats()
+        self.assertEqual(stats["completed"], {IORING_OP_NOP: 1})
+        self.assertEqual(stats["latency"], {})
+
+    def tearDown(self):
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
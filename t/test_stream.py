@@ -0,0 +1,86 @@
+import errno
+import hashlib
+import os
+import tempfile
+import unittest
+
+from py_io_uring import IoUring, FileStream
+
+class TestStream(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(8, 0)
+        self.ring = ring
+        self.file = tempfile.TemporaryFile()
+        self.data = os.urandom((1 << 20) + 1234)
+        self.file.write(self.data)
+        self.file.flush()
+
+    def test_stream(self):
+        stream = self.ring.stream_file(self.file.fileno(), 65536, 16)
+        self.assertIsInstance(stream, FileStream)
+        h = hashlib.sha256()
+        sizes = []
+        for chunk in stream:
+            self.assertTrue(chunk.readonly)
+            h.update(chunk)
+            sizes.append(len(chunk))
+        self.assertEqual(h.digest(), hashlib.sha256(self.data).digest())
+        self.assertEqual(sizes, [65536] * 16 + [1234])
+        self.assertRaises(StopIteration, next, stream)
+        # nothing is left behind in the ring
+        self.assertEqual(self.ring.cq_ready(), 0)
+
+    def test_offset_length(self):
+        stream = self.ring.stream_file(self.file.fileno(), 1000, 3, 500, 4500)
+        self.assertEqual(b"".join(bytes(c) for c in stream), self.data[500:5000])
+
+    def test_chunk_released(self):
+        stream = self.ring.stream_file(self.file.fileno(), 4096, 2)
+        first = next(stream)
+        self.assertEqual(first, self.data[:4096])
+        second = next(stream)
+        self.assertRaises(ValueError, len, first)
+        held = memoryview(second)[:10]
+        self.assertRaises(BufferError, next, stream)
+        held.release()
+        self.assertEqual(next(stream), self.data[8192:12288])
+        stream.close()
+        self.assertRaises(StopIteration, next, stream)
+        self.assertRaises(BufferError, memoryview, stream)
+
+    def test_interleaved(self):
+        # completions of others stay in ring for drain
+        stream = self.ring.stream_file(self.file.fileno(), 65536, 4)
+        total = 0
+        for i, chunk in enumerate(stream):
+            if i % 4 == 0:
+                sqe = self.ring.get_sqe()
+                sqe.prep_nop()
+                sqe.set_data(i)
+                self.ring.submit()
+            if i % 8 == 7:
+                self.assertEqual(len(self.ring.drain()), 2)
+            total += len(chunk)
+        self.assertEqual(total, len(self.data))
+        self.assertEqual(self.ring.drain(), [(16, None, 0)])
+
+    def test_error(self):
+        r, w = os.pipe()
+        os.close(w)
+        os.close(r)
+        stream = self.ring.stream_file(r)
+        with self.assertRaises(OSError) as cm:
+            next(stream)
+        self.assertEqual(cm.exception.errno, errno.EBADF)
+        self.assertRaises(StopIteration, next, stream)
+        self.assertRaises(ValueError, self.ring.stream_file, 0, 0)
+
+    def tearDown(self):
+        self.file.close()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
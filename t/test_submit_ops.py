@@ -0,0 +1,92 @@
+import errno
+import os
+import tempfile
+import unittest
+from socket import *
+
+import py_io_uring
+from py_io_uring import (IoUring, IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE,
+        IORING_OP_READV, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_FSYNC,
+        IORING_OP_CLOSE, IOSQE_IO_LINK)
+
+class TestSubmitOps(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(8, 0)
+        self.ring = ring
+
+    def test_file(self):
+        ring = self.ring
+        with tempfile.TemporaryFile() as f:
+            fd = f.fileno()
+            buf = bytearray(5)
+            a, b = bytearray(3), bytearray(8)
+            n = ring.submit_ops([
+                (IORING_OP_WRITE, fd, b"hello world", 0, IOSQE_IO_LINK, "write"),
+                (IORING_OP_FSYNC, fd, None, 0, IOSQE_IO_LINK, "fsync"),
+                (IORING_OP_READ, fd, 5, 0, IOSQE_IO_LINK, "read"),
+                (IORING_OP_READ, fd, buf, 6, IOSQE_IO_LINK, "read_into"),
+                (IORING_OP_READV, fd, [a, b], 0, 0, "readv"),
+            ])
+            self.assertEqual(n, 5)
+            results = dict((data, res) for data, res, flags in ring.drain(5))
+            self.assertEqual(results, {"write": 11, "fsync": 0, "read": b"hello",
+                    "read_into": 5, "readv": 11})
+            self.assertEqual(buf, b"world")
+            self.assertEqual(a + b, b"hello world")
+
+    def test_fan_out(self):
+        ring = self.ring
+        pairs = [socketpair() for i in range(20)]
+        try:
+            # more ops than the submission queue holds
+            ops = [(IORING_OP_SEND, a.fileno(), b"replica", 0, 0, i)
+                    for i, (a, b) in enumerate(pairs)]
+            self.assertEqual(ring.submit_ops(ops), 20)
+            results = []
+            while len(results) < 20:
+                results.extend(ring.drain(1))
+            self.assertEqual(sorted(results), [(i, 7, 0) for i in range(20)])
+            for a, b in pairs:
+                self.assertEqual(b.recv(16), b"replica")
+            ops = [(IORING_OP_RECV, a.fileno(), 16, -1, 0, i)
+                    for i, (a, b) in enumerate(pairs[:4])]
+            for a, b in pairs[:4]:
+                b.send(b"back")
+            ring.submit_ops(ops, 4)
+            self.assertEqual(ring.cq_ready(), 4)
+            self.assertEqual(sorted(ring.drain()), [(i, b"back", 0) for i in range(4)])
+        finally:
+            for a, b in pairs:
+                a.close()
+                b.close()
+
+    def test_close(self):
+        ring = self.ring
+        fd = os.open(os.devnull, os.O_RDONLY)
+        ring.submit_ops([(IORING_OP_CLOSE, fd, None, 0, 0, None)])
+        self.assertEqual(ring.drain(1), [(None, 0, 0)])
+        with self.assertRaises(OSError):
+            os.fstat(fd)
+
+    def test_invalid(self):
+        ring = self.ring
+        for bad in [(IORING_OP_NOP, 0), (-1, 0, None, 0, 0, None),
+                (IORING_OP_WRITE, 0, "str", 0, 0, None),
+                (IORING_OP_NOP, 0, None, 0, 0x80000, None), None]:
+            with self.assertRaises((TypeError, ValueError)):
+                ring.submit_ops([(IORING_OP_NOP, -1, None, 0, 0, "before"), bad,
+                        (IORING_OP_NOP, -1, None, 0, 0, "after")])
+            # ops before the bad one are submitted, a nop takes its place
+            self.assertEqual(ring.drain(2), [("before", None, 0), (None, None, 0)])
+        with self.assertRaises(TypeError):
+            ring.submit_ops(1)
+        self.assertEqual(ring.submit_ops([]), 0)
+
+    def tearDown(self):
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
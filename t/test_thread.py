@@ -0,0 +1,84 @@
+import threading
+import time
+import unittest
+
+from py_io_uring import IoUring
+
+class TestThread(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+
+    def test_wait_cqe_release_gil(self):
+        ring = self.ring
+        waited = []
+
+        def waiter():
+            cqe = ring.wait_cqe()
+            waited.append(cqe.get_data())
+            ring.cqe_seen(cqe)
+
+        t = threading.Thread(target=waiter, daemon=True)
+        t.start()
+
+        # this thread must keep running while waiter sleeps in kernel
+        progress = 0
+        deadline = time.monotonic() + 0.2
+        while time.monotonic() < deadline:
+            progress += 1
+        self.assertTrue(t.is_alive())
+        self.assertGreater(progress, 1000)
+        self.assertEqual(waited, [])
+
+        # and be able to submit to the same ring meanwhile
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_data("wakeup")
+        self.assertEqual(ring.submit(), 1)
+        t.join(5)
+        self.assertFalse(t.is_alive())
+        self.assertEqual(waited, ["wakeup"])
+
+    def test_queue_exit_while_waiting(self):
+        ring = self.ring
+        t = threading.Thread(target=ring.wait_cqe, daemon=True)
+        t.start()
+        time.sleep(0.1)
+        self.assertRaises(RuntimeError, ring.queue_exit)
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        ring.submit()
+        t.join(5)
+        self.assertFalse(t.is_alive())
+
+    def test_submit_during_timed_wait(self):
+        ring = self.ring
+        waited = []
+
+        def waiter():
+            [cqe] = ring.wait_cqes(1, 5)
+            waited.append(cqe.get_data())
+            ring.cqe_seen(cqe)
+
+        t = threading.Thread(target=waiter, daemon=True)
+        t.start()
+        time.sleep(0.1)
+        # a timed wait must not keep other threads from submitting
+        start = time.monotonic()
+        sqe = ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_data("wakeup")
+        ring.submit()
+        self.assertLess(time.monotonic() - start, 1)
+        t.join(5)
+        self.assertFalse(t.is_alive())
+        self.assertEqual(waited, ["wakeup"])
+
+    def tearDown(self):
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,176 @@
+import time
+import unittest
+
+from py_io_uring import IoUring, TimerWheel, IORING_OP_TIMEOUT
+
+class TestTimerWheel(unittest.TestCase):
+
+    def setUp(self):
+        ring = IoUring()
+        ring.queue_init(32, 0)
+        self.ring = ring
+        self.wheel = TimerWheel(ring)
+        self.calls = []
+
+    def record(self, *args):
+        self.calls.append(args)
+
+    def run_until(self, n, limit=2):
+        deadline = time.monotonic() + limit
+        while len(self.calls) < n and time.monotonic() < deadline:
+            self.ring.run(32, 0.5)
+
+    def test_order(self):
+        wheel = self.wheel
+        start = time.monotonic()
+        for delay in (0.03, 0.01, 0.02, 0):
+            wheel.add(delay, self.record, delay)
+        self.assertEqual(len(wheel), 4)
+        self.run_until(4)
+        self.assertEqual(self.calls, [(0,), (0.01,), (0.02,), (0.03,)])
+        self.assertGreaterEqual(time.monotonic() - start, 0.03)
+        self.assertEqual(len(wheel), 0)
+
+    def test_not_early(self):
+        fired = []
+        start = time.monotonic()
+        self.wheel.add(0.05, lambda: fired.append(time.monotonic() - start))
+        while not fired:
+            self.ring.run(32, 1)
+        self.assertGreaterEqual(fired[0], 0.05)
+
+    def test_cancel(self):
+        wheel = self.wheel
+        handles = [wheel.add(0.01, self.record, i) for i in range(100)]
+        for h in handles[::2]:
+            self.assertTrue(wheel.cancel(h))
+        self.assertFalse(wheel.cancel(handles[0]))
+        self.assertFalse(wheel.cancel(12345 << 32))
+        self.assertEqual(len(wheel), 50)
+        self.run_until(50)
+        self.assertEqual(sorted(self.calls), [(i,) for i in range(1, 100, 2)])
+        # handle of a called timer is stale even when its node is reused
+        self.assertFalse(wheel.cancel(handles[1]))
+        wheel.add(10, self.record)
+        self.assertFalse(wheel.cancel(handles[1]))
+
+    def test_many(self):
+        # cascading through levels, timers spread over 64^2 ticks
+        self.wheel.close()
+        wheel = TimerWheel(self.ring, 0.00005)
+        def fired(bounds):
+            self.calls.append((bounds, time.monotonic()))
+        for i in range(5000):
+            # the deadline is taken by add, somewhere in between
+            delay = (i * 7 % 250) * 0.001
+            bounds = [time.monotonic() + delay]
+            wheel.add(delay, fired, bounds)
+            bounds.append(time.monotonic() + delay)
+        self.run_until(5000, 5)
+        self.assertEqual(len(self.calls), 5000)
+        for (earliest, latest), at in self.calls:
+            self.assertGreaterEqual(at, earliest)
+        # called in deadline order, give or take a tick
+        bounds = [bounds for bounds, at in self.calls]
+        for (a, _), (_, b) in zip(bounds, bounds[1:]):
+            self.assertLess(a, b + 0.0001)
+        wheel.close()
+
+    def test_one_timeout(self):
+        ring = self.ring
+        ring.enable_stats()
+        handles = [self.wheel.add(delay * 0.001, self.record) for delay in range(1000, 0, -1)]
+        for h in handles:
+            self.wheel.cancel(h)
+        self.assertEqual(ring.submit(), 1)
+        self.assertEqual(ring.stats()["submitted"], {IORING_OP_TIMEOUT: 1})
+        # an earlier timer after the timeout is submitted updates it
+        self.wheel.add(0.5, self.record, "late")
+        start = time.monotonic()
+        self.wheel.add(0.01, self.record, "early")
+        ring.submit()
+        self.run_until(1)
+        self.assertEqual(self.calls, [("early",)])
+        self.assertLess(time.monotonic() - start, 0.4)
+
+    def test_far(self):
+        # beyond the range of the wheel at 1us resolution
+        self.wheel.close()
+        wheel = TimerWheel(self.ring, 0.000001)
+        handle = wheel.add(1e6, self.record)
+        wheel.add(0.001, self.record, "near")
+        self.run_until(1)
+        self.assertEqual(self.calls, [("near",)])
+        self.assertTrue(wheel.cancel(handle))
+        wheel.close()
+
+    def test_callback_adds(self):
+        wheel = self.wheel
+        def again(n):
+            self.calls.append(n)
+            if n < 3:
+                wheel.add(0.001, again, n + 1)
+        wheel.add(0, again, 0)
+        self.run_until(4)
+        self.assertEqual(self.calls, [0, 1, 2, 3])
+
+    def test_drain_and_expire(self):
+        # completions of the wheel never show up, expire calls timers
+        wheel = self.wheel
+        wheel.add(0.01, self.record, "t")
+        sqe = self.ring.get_sqe()
+        sqe.prep_nop()
+        sqe.set_data("nop")
+        self.ring.submit()
+        self.assertEqual(self.ring.drain(1), [("nop", None, 0)])
+        time.sleep(0.02)
+        self.assertEqual(self.ring.drain(1), [])
+        self.assertEqual(wheel.expire(), 1)
+        self.assertEqual(self.calls, [("t",)])
+
+    def test_errors(self):
+        wheel = self.wheel
+        def fail():
+            raise RuntimeError("timer")
+        wheel.add(0, fail)
+        wheel.add(0, self.record, "after")
+        with self.assertRaisesRegex(RuntimeError, "timer"):
+            self.run_until(1)
+        self.assertEqual(self.calls, [("after",)])
+        with self.assertRaises(TypeError):
+            wheel.add(1, None)
+        with self.assertRaises(ValueError):
+            TimerWheel(self.ring)
+        with self.assertRaises(ValueError):
+            TimerWheel(IoUring(), 0)
+
+    def test_close(self):
+        wheel = self.wheel
+        wheel.add(0.01, self.record)
+        wheel.close()
+        self.assertEqual(len(wheel), 0)
+        time.sleep(0.02)
+        self.assertEqual(self.ring.run(32, 0.05), [])
+        self.assertEqual(self.calls, [])
+        with self.assertRaises(ValueError):
+            wheel.add(0, self.record)
+        # the ring takes another wheel
+        TimerWheel(self.ring).close()
+
+    def test_requeue(self):
+        # timers survive queue_exit and fire once the ring is back
+        wheel = self.wheel
+        wheel.add(0.01, self.record)
+        self.ring.queue_exit()
+        self.ring.queue_init(32, 0)
+        wheel.add(0.02, self.record)
+        self.run_until(2)
+        self.assertEqual(len(self.calls), 2)
+
+    def tearDown(self):
+        self.wheel.close()
+        self.ring.queue_exit()
+
+
+if __name__ == '__main__':
+    unittest.main()